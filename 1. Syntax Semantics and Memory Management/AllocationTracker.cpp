@@ -0,0 +1,281 @@
+#include "AllocationTracker.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <new>
+#include <ostream>
+
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+/**
+ * The hooks must not allocate through operator new themselves, so all
+ * bookkeeping lives in fixed, statically initialized tables of atomics
+ * and blocks come from malloc. Each block carries a small header in front
+ * of the caller's memory recording its size and site, so frees are
+ * charged back to the site that allocated them.
+ */
+
+namespace {
+
+// Site table: open addressing on the site key (label or return address).
+// Slot 0 collects sites that no longer fit.
+constexpr std::size_t siteCapacity = 4096;
+
+struct Site {
+    std::atomic<const void*> key{nullptr};
+    std::atomic<bool> labelled{false};
+    std::atomic<std::uint64_t> allocations{0};
+    std::atomic<std::uint64_t> bytesAllocated{0};
+    std::atomic<std::uint64_t> liveAllocations{0};
+    std::atomic<std::uint64_t> liveBytes{0};
+};
+
+Site siteTable[siteCapacity];
+
+std::atomic<std::uint64_t> totalAllocations{0};
+std::atomic<std::uint64_t> totalFrees{0};
+std::atomic<std::uint64_t> totalBytes{0};
+std::atomic<std::uint64_t> liveBytes{0};
+std::atomic<std::uint64_t> peakLiveBytes{0};
+
+thread_local const char* currentLabel = nullptr;
+
+// Sits immediately before the pointer handed to the caller
+struct alignas(16) BlockHeader {
+    std::size_t size;
+    std::uint32_t site;
+    std::uint32_t offset; // From the malloc'ed base to the caller's pointer
+};
+
+static_assert(sizeof(BlockHeader) == 16, "block header must keep 16-byte alignment");
+
+std::uint32_t siteFor(const void* key, bool labelled) {
+    std::size_t start = static_cast<std::size_t>((reinterpret_cast<std::uintptr_t>(key) * 0x9E3779B97F4A7C15ull) >> 52);
+    for (std::size_t probe = 0; probe < siteCapacity - 1; probe++) {
+        std::size_t slot = 1 + (start + probe) % (siteCapacity - 1);
+        const void* existing = siteTable[slot].key.load(std::memory_order_acquire);
+        if (existing == nullptr) {
+            if (siteTable[slot].key.compare_exchange_strong(existing, key, std::memory_order_acq_rel)) {
+                siteTable[slot].labelled.store(labelled, std::memory_order_relaxed);
+                return static_cast<std::uint32_t>(slot);
+            }
+        }
+        if (existing == key) {
+            return static_cast<std::uint32_t>(slot);
+        }
+    }
+    return 0;
+}
+
+void* allocate(std::size_t size, std::size_t alignment, const void* caller, bool nothrow) {
+    std::size_t offset = std::max(alignment, sizeof(BlockHeader));
+    if (size > SIZE_MAX - offset) {
+        if (nothrow) {
+            return nullptr;
+        }
+        throw std::bad_alloc();
+    }
+    void* base = nullptr;
+    for (;;) {
+        if (offset == sizeof(BlockHeader)) {
+            base = std::malloc(size + offset);
+        } else if (posix_memalign(&base, offset, size + offset) != 0) {
+            base = nullptr;
+        }
+        if (base != nullptr) {
+            break;
+        }
+        std::new_handler handler = std::get_new_handler();
+        if (handler == nullptr) {
+            if (nothrow) {
+                return nullptr;
+            }
+            throw std::bad_alloc();
+        }
+        handler();
+    }
+
+    const char* label = currentLabel;
+    std::uint32_t site = label != nullptr ? siteFor(label, true) : siteFor(caller, false);
+    Site& entry = siteTable[site];
+    entry.allocations.fetch_add(1, std::memory_order_relaxed);
+    entry.bytesAllocated.fetch_add(size, std::memory_order_relaxed);
+    entry.liveAllocations.fetch_add(1, std::memory_order_relaxed);
+    entry.liveBytes.fetch_add(size, std::memory_order_relaxed);
+    totalAllocations.fetch_add(1, std::memory_order_relaxed);
+    totalBytes.fetch_add(size, std::memory_order_relaxed);
+    std::uint64_t live = liveBytes.fetch_add(size, std::memory_order_relaxed) + size;
+    std::uint64_t peak = peakLiveBytes.load(std::memory_order_relaxed);
+    while (live > peak && !peakLiveBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {
+    }
+
+    char* user = static_cast<char*>(base) + offset;
+    BlockHeader* header = reinterpret_cast<BlockHeader*>(user) - 1;
+    header->size = size;
+    header->site = site;
+    header->offset = static_cast<std::uint32_t>(offset);
+    return user;
+}
+
+void release(void* pointer) noexcept {
+    if (pointer == nullptr) {
+        return;
+    }
+    BlockHeader* header = static_cast<BlockHeader*>(pointer) - 1;
+    Site& entry = siteTable[header->site];
+    entry.liveAllocations.fetch_sub(1, std::memory_order_relaxed);
+    entry.liveBytes.fetch_sub(header->size, std::memory_order_relaxed);
+    totalFrees.fetch_add(1, std::memory_order_relaxed);
+    liveBytes.fetch_sub(header->size, std::memory_order_relaxed);
+    std::free(static_cast<char*>(pointer) - header->offset);
+}
+
+// "function+0x1f" for a code address, or the bare address if unknown
+std::string describe(const void* address) {
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%p", address);
+    Dl_info info{};
+    if (dladdr(address, &info) == 0 || info.dli_sname == nullptr) {
+        return buffer;
+    }
+    int status = 0;
+    char* demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+    std::string name = status == 0 && demangled != nullptr ? demangled : info.dli_sname;
+    std::free(demangled);
+    std::snprintf(buffer, sizeof(buffer), "+0x%zx",
+                  static_cast<std::size_t>(static_cast<const char*>(address) - static_cast<const char*>(info.dli_saddr)));
+    return name + buffer;
+}
+
+AllocationSiteStats snapshot(std::size_t slot) {
+    const Site& entry = siteTable[slot];
+    AllocationSiteStats site;
+    const void* key = entry.key.load(std::memory_order_acquire);
+    site.labelled = entry.labelled.load(std::memory_order_relaxed);
+    site.site = slot == 0 ? "(other sites)" : site.labelled ? static_cast<const char*>(key) : describe(key);
+    site.allocations = entry.allocations.load(std::memory_order_relaxed);
+    site.bytesAllocated = entry.bytesAllocated.load(std::memory_order_relaxed);
+    site.liveAllocations = entry.liveAllocations.load(std::memory_order_relaxed);
+    site.liveBytes = entry.liveBytes.load(std::memory_order_relaxed);
+    return site;
+}
+
+} // namespace
+
+AllocationStats AllocationTracker::stats() {
+    AllocationStats result;
+    result.allocations = totalAllocations.load(std::memory_order_relaxed);
+    result.frees = totalFrees.load(std::memory_order_relaxed);
+    result.bytesAllocated = totalBytes.load(std::memory_order_relaxed);
+    result.liveAllocations = result.allocations - result.frees;
+    result.liveBytes = liveBytes.load(std::memory_order_relaxed);
+    result.peakLiveBytes = peakLiveBytes.load(std::memory_order_relaxed);
+    return result;
+}
+
+std::vector<AllocationSiteStats> AllocationTracker::sites() {
+    std::vector<AllocationSiteStats> result;
+    for (std::size_t slot = 0; slot < siteCapacity; slot++) {
+        if (siteTable[slot].allocations.load(std::memory_order_relaxed) != 0) {
+            result.push_back(snapshot(slot));
+        }
+    }
+    std::sort(result.begin(), result.end(), [](const AllocationSiteStats& a, const AllocationSiteStats& b) {
+        return a.bytesAllocated > b.bytesAllocated;
+    });
+    return result;
+}
+
+std::vector<AllocationSiteStats> AllocationTracker::leaks() {
+    std::vector<AllocationSiteStats> result;
+    for (std::size_t slot = 0; slot < siteCapacity; slot++) {
+        if (siteTable[slot].liveAllocations.load(std::memory_order_relaxed) != 0) {
+            result.push_back(snapshot(slot));
+        }
+    }
+    std::sort(result.begin(), result.end(), [](const AllocationSiteStats& a, const AllocationSiteStats& b) {
+        return a.liveBytes > b.liveBytes;
+    });
+    return result;
+}
+
+std::size_t AllocationTracker::peakRssKb() {
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return static_cast<std::size_t>(usage.ru_maxrss); // KiB on Linux
+}
+
+std::size_t AllocationTracker::currentRssKb() {
+    std::FILE* statm = std::fopen("/proc/self/statm", "r");
+    if (statm == nullptr) {
+        return 0;
+    }
+    unsigned long pages = 0, resident = 0;
+    int fields = std::fscanf(statm, "%lu %lu", &pages, &resident);
+    std::fclose(statm);
+    return fields == 2 ? static_cast<std::size_t>(resident) * static_cast<std::size_t>(sysconf(_SC_PAGESIZE)) / 1024 : 0;
+}
+
+void AllocationTracker::report(std::ostream& out, std::size_t topSites) {
+    AllocationStats totals = stats();
+    out << "Allocations: " << totals.allocations << " (" << totals.bytesAllocated << " bytes), frees: "
+        << totals.frees << '\n';
+    out << "Live: " << totals.liveAllocations << " allocations, " << totals.liveBytes << " bytes (peak "
+        << totals.peakLiveBytes << " bytes)\n";
+    out << "RSS: " << currentRssKb() << " KiB (peak " << peakRssKb() << " KiB)\n";
+    std::vector<AllocationSiteStats> all = sites();
+    for (std::size_t i = 0; i < all.size() && i < topSites; i++) {
+        const AllocationSiteStats& site = all[i];
+        out << "  " << std::setw(10) << site.allocations << " allocs " << std::setw(12) << site.bytesAllocated
+            << " bytes " << std::setw(8) << site.liveAllocations << " live  " << site.site << '\n';
+    }
+}
+
+AllocationScope::AllocationScope(const char* label) : previous(currentLabel) { currentLabel = label; }
+
+AllocationScope::~AllocationScope() { currentLabel = previous; }
+
+// Global allocation functions. Every form funnels into allocate()/release();
+// the sized and aligned deletes need no extra information, since the block
+// header already records the size and the offset to the malloc'ed base.
+
+void* operator new(std::size_t size) { return allocate(size, 0, __builtin_return_address(0), false); }
+void* operator new[](std::size_t size) { return allocate(size, 0, __builtin_return_address(0), false); }
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    return allocate(size, 0, __builtin_return_address(0), true);
+}
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+    return allocate(size, 0, __builtin_return_address(0), true);
+}
+void* operator new(std::size_t size, std::align_val_t alignment) {
+    return allocate(size, static_cast<std::size_t>(alignment), __builtin_return_address(0), false);
+}
+void* operator new[](std::size_t size, std::align_val_t alignment) {
+    return allocate(size, static_cast<std::size_t>(alignment), __builtin_return_address(0), false);
+}
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return allocate(size, static_cast<std::size_t>(alignment), __builtin_return_address(0), true);
+}
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return allocate(size, static_cast<std::size_t>(alignment), __builtin_return_address(0), true);
+}
+
+void operator delete(void* pointer) noexcept { release(pointer); }
+void operator delete[](void* pointer) noexcept { release(pointer); }
+void operator delete(void* pointer, std::size_t) noexcept { release(pointer); }
+void operator delete[](void* pointer, std::size_t) noexcept { release(pointer); }
+void operator delete(void* pointer, const std::nothrow_t&) noexcept { release(pointer); }
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept { release(pointer); }
+void operator delete(void* pointer, std::align_val_t) noexcept { release(pointer); }
+void operator delete[](void* pointer, std::align_val_t) noexcept { release(pointer); }
+void operator delete(void* pointer, std::size_t, std::align_val_t) noexcept { release(pointer); }
+void operator delete[](void* pointer, std::size_t, std::align_val_t) noexcept { release(pointer); }
+void operator delete(void* pointer, std::align_val_t, const std::nothrow_t&) noexcept { release(pointer); }
+void operator delete[](void* pointer, std::align_val_t, const std::nothrow_t&) noexcept { release(pointer); }
@@ -0,0 +1,74 @@
+#ifndef ALLOCATION_TRACKER_H
+#define ALLOCATION_TRACKER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+/**
+ * Allocation tracking and leak detection
+ * Linking AllocationTracker.cpp into a program replaces the global
+ * operator new/delete with hooks that count every allocation, overall and
+ * per call site, e.g.
+ *   g++ -std=c++17 -DALLOCATION_TRACKING MemoryAnalysis.cpp AllocationTracker.cpp
+ * A call site is the innermost AllocationScope label active on the
+ * allocating thread, or else the code address that called operator new.
+ */
+
+// Process-wide totals since start-up
+struct AllocationStats {
+    std::uint64_t allocations = 0;
+    std::uint64_t frees = 0;
+    std::uint64_t bytesAllocated = 0;
+    std::uint64_t liveAllocations = 0; // Allocated and not yet freed
+    std::uint64_t liveBytes = 0;
+    std::uint64_t peakLiveBytes = 0;
+};
+
+// Counters for one call site
+struct AllocationSiteStats {
+    std::string site; // Scope label, or symbolized caller address
+    bool labelled = false;
+    std::uint64_t allocations = 0;
+    std::uint64_t bytesAllocated = 0;
+    std::uint64_t liveAllocations = 0;
+    std::uint64_t liveBytes = 0;
+};
+
+class AllocationTracker {
+public:
+    static AllocationStats stats();
+
+    // Every site seen so far, most bytes allocated first. Sites beyond the
+    // tracker's fixed table are pooled under "(other sites)".
+    static std::vector<AllocationSiteStats> sites();
+
+    // Sites with allocations still live, most live bytes first
+    static std::vector<AllocationSiteStats> leaks();
+
+    // Resident set size in KiB: the high-water mark and the current value
+    static std::size_t peakRssKb();
+    static std::size_t currentRssKb();
+
+    // Totals, RSS and the topSites busiest sites
+    static void report(std::ostream& out, std::size_t topSites = 10);
+};
+
+// AllocationScope - attributes allocations made on this thread to a label
+// while in scope (scopes nest; the innermost wins). The label must outlive
+// the program, e.g. a string literal.
+class AllocationScope {
+private:
+    const char* previous;
+
+public:
+    explicit AllocationScope(const char* label);
+    ~AllocationScope();
+
+    AllocationScope(const AllocationScope&) = delete;
+    AllocationScope& operator=(const AllocationScope&) = delete;
+};
+
+#endif
@@ -1,6 +1,29 @@
 #include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#if defined(USE_PAR_UNSEQ) // Build with -DUSE_PAR_UNSEQ -ltbb
+#include <execution>
+#include <numeric>
+#endif
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 using namespace std;
- 
+
+// Original version: accumulates into an int, so large arrays silently overflow
 int calculateSum(int arr[], int size) {
     int total = 0;
     for (int i = 0; i < size; i++) {
@@ -8,11 +31,264 @@ int calculateSum(int arr[], int size) {
     }
     return total;
 }
- 
-int main () {
+
+// Accumulator wide enough that summing a span does not overflow:
+// integers narrower than 64 bits widen to 64 bits, float widens to double
+template <typename T>
+using WideAccumulator = conditional_t<is_floating_point_v<T>, conditional_t<(sizeof(T) < sizeof(double)), double, T>,
+                                      conditional_t<is_signed_v<T>, int64_t, uint64_t>>;
+
+// Folds values into init with op, which must be associative and commutative.
+// Four independent accumulators are kept so each step does not wait for the
+// previous one to finish (the compiler can also vectorize across them).
+template <typename T, typename Acc, typename Op>
+Acc reduce(span<const T> values, Acc init, Op op) {
+    size_t n = values.size();
+    if (n < 8) {
+        for (const T& value : values) {
+            init = op(init, Acc(value));
+        }
+        return init;
+    }
+    Acc a0 = op(init, Acc(values[0])), a1 = Acc(values[1]), a2 = Acc(values[2]), a3 = Acc(values[3]);
+    size_t i = 4;
+    for (; i + 4 <= n; i += 4) {
+        a0 = op(a0, Acc(values[i]));
+        a1 = op(a1, Acc(values[i + 1]));
+        a2 = op(a2, Acc(values[i + 2]));
+        a3 = op(a3, Acc(values[i + 3]));
+    }
+    for (; i < n; i++) {
+        a0 = op(a0, Acc(values[i]));
+    }
+    return op(op(a0, a1), op(a2, a3));
+}
+
+// Sum in the widened accumulator
+template <typename T>
+WideAccumulator<T> sum(span<const T> values) {
+    using Acc = WideAccumulator<T>;
+    return reduce(values, Acc{}, plus<Acc>());
+}
+
+// int is the common case for metrics counters, so it gets an explicit SIMD
+// kernel: each vector of ints is sign-extended to 64-bit lanes by
+// interleaving it with its sign mask (in-lane unpacks, cheaper than the
+// cross-lane widening load; lane order does not matter for a sum) and added
+// into four vector accumulators to hide the add latency
+template <>
+int64_t sum(span<const int> values) {
+    size_t i = 0;
+    int64_t total = 0;
+#if defined(__AVX2__) || defined(__SSE2__)
+    const int* data = values.data();
+    size_t n = values.size();
+#endif
+#if defined(__AVX2__)
+    __m256i acc[4] = {_mm256_setzero_si256(), _mm256_setzero_si256(), _mm256_setzero_si256(), _mm256_setzero_si256()};
+    for (; i + 16 <= n; i += 16) {
+        for (int k = 0; k < 2; k++) {
+            __m256i eight = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + 8 * k));
+            __m256i sign = _mm256_srai_epi32(eight, 31);
+            acc[2 * k] = _mm256_add_epi64(acc[2 * k], _mm256_unpacklo_epi32(eight, sign));
+            acc[2 * k + 1] = _mm256_add_epi64(acc[2 * k + 1], _mm256_unpackhi_epi32(eight, sign));
+        }
+    }
+    __m256i both = _mm256_add_epi64(_mm256_add_epi64(acc[0], acc[1]), _mm256_add_epi64(acc[2], acc[3]));
+    int64_t lanes[4];
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), both);
+    total = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#elif defined(__SSE2__)
+    __m128i acc[4] = {_mm_setzero_si128(), _mm_setzero_si128(), _mm_setzero_si128(), _mm_setzero_si128()};
+    for (; i + 8 <= n; i += 8) {
+        for (int k = 0; k < 2; k++) {
+            __m128i four = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + 4 * k));
+            __m128i sign = _mm_srai_epi32(four, 31);
+            acc[2 * k] = _mm_add_epi64(acc[2 * k], _mm_unpacklo_epi32(four, sign));
+            acc[2 * k + 1] = _mm_add_epi64(acc[2 * k + 1], _mm_unpackhi_epi32(four, sign));
+        }
+    }
+    __m128i both = _mm_add_epi64(_mm_add_epi64(acc[0], acc[1]), _mm_add_epi64(acc[2], acc[3]));
+    int64_t lanes[2];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), both);
+    total = lanes[0] + lanes[1];
+#endif
+    return total + reduce(values.subspan(i), int64_t{0}, plus<int64_t>());
+}
+
+// Worker threads kept alive between reductions, so a parallel sum costs two
+// condition variable hand-offs per worker instead of creating and joining
+// threads on every call. The calling thread runs part 0 itself; run() calls
+// from several threads take turns.
+class ReductionPool {
+private:
+    vector<thread> workers;
+    mutex runLock;   // Serializes run() callers
+    mutex stateLock; // Guards the fields below
+    condition_variable wake;
+    condition_variable done;
+    void (*invoke)(const void*, size_t) = nullptr;
+    const void* task = nullptr;
+    size_t parts = 0;
+    size_t generation = 0;
+    size_t pending = 0;
+    bool stopping = false;
+
+    void work(size_t part) {
+        size_t seen = 0;
+        unique_lock<mutex> lock(stateLock);
+        for (;;) {
+            wake.wait(lock, [&] { return stopping || generation != seen; });
+            if (stopping) {
+                return;
+            }
+            seen = generation;
+            if (part < parts) {
+                lock.unlock();
+                invoke(task, part);
+                lock.lock();
+            }
+            if (--pending == 0) {
+                done.notify_one();
+            }
+        }
+    }
+
+public:
+    explicit ReductionPool(size_t threads) {
+        for (size_t part = 1; part < max<size_t>(1, threads); part++) {
+            workers.emplace_back([this, part] { work(part); });
+        }
+    }
+
+    ~ReductionPool() {
+        {
+            lock_guard<mutex> lock(stateLock);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (thread& worker : workers) {
+            worker.join();
+        }
+    }
+
+    ReductionPool(const ReductionPool&) = delete;
+    ReductionPool& operator=(const ReductionPool&) = delete;
+
+    size_t size() const { return workers.size() + 1; }
+
+    // Calls fn(part) for every part below partCount (at most size()) and
+    // returns once all have finished
+    template <typename Fn>
+    void run(size_t partCount, const Fn& fn) {
+        lock_guard<mutex> turn(runLock);
+        {
+            lock_guard<mutex> lock(stateLock);
+            invoke = [](const void* context, size_t part) { (*static_cast<const Fn*>(context))(part); };
+            task = &fn;
+            parts = min(partCount, size());
+            pending = workers.size();
+            generation++;
+        }
+        wake.notify_all();
+        fn(0);
+        unique_lock<mutex> lock(stateLock);
+        done.wait(lock, [&] { return pending == 0; });
+    }
+
+    // One thread per hardware thread, started on first use
+    static ReductionPool& shared() {
+        static ReductionPool pool(max(1u, thread::hardware_concurrency()));
+        return pool;
+    }
+};
+
+// Parallel sum for large arrays: the span is split into one contiguous chunk
+// per thread of ReductionPool::shared() and the partial sums are added in
+// chunk order, so integer results match sum() exactly. Small inputs are
+// summed on the calling thread. threadCount 0 means one chunk per pool
+// thread; it is capped at the pool size.
+template <typename T>
+WideAccumulator<T> parallelSum(span<const T> values, size_t threadCount = 0) {
+    using Acc = WideAccumulator<T>;
+    constexpr size_t minChunk = 1 << 16;
+#if defined(USE_PAR_UNSEQ)
+    (void)threadCount;
+    if (values.size() < minChunk) {
+        return sum(values);
+    }
+    return std::reduce(execution::par_unseq, values.begin(), values.end(), Acc{},
+                       [](Acc a, Acc b) { return a + b; });
+#else
+    ReductionPool& pool = ReductionPool::shared();
+    threadCount = max<size_t>(1, min({threadCount ? threadCount : pool.size(), pool.size(), values.size() / minChunk}));
+    if (threadCount == 1) {
+        return sum(values);
+    }
+    vector<Acc> partial(threadCount);
+    size_t chunk = (values.size() + threadCount - 1) / threadCount;
+    pool.run(threadCount, [&](size_t t) {
+        span<const T> part = values.subspan(min(values.size(), t * chunk));
+        partial[t] = sum(part.first(min(chunk, part.size())));
+    });
+    Acc total{};
+    for (Acc part : partial) {
+        total += part;
+    }
+    return total;
+#endif
+}
+
+// Times fn over several runs and reports the best run in ns per element.
+// Each run repeats fn over at least 16M elements so small arrays are not
+// dominated by timer overhead.
+template <typename Fn>
+void benchmark(const char* name, size_t elements, Fn fn) {
+    size_t repeats = max<size_t>(1, (size_t{1} << 24) / max<size_t>(1, elements));
+    double best = 1e300;
+    for (int run = 0; run < 10; run++) {
+        auto begin = chrono::steady_clock::now();
+        for (size_t r = 0; r < repeats; r++) {
+            auto result = fn();
+            asm volatile("" : : "r,m"(result) : "memory"); // Keep the result alive
+        }
+        chrono::duration<double, nano> elapsed = chrono::steady_clock::now() - begin;
+        best = min(best, elapsed.count());
+    }
+    cout << name << ": " << best / static_cast<double>(elements * repeats) << " ns/element" << endl;
+}
+
+int main (int argc, char* argv[]) {
     int numbers [] = {1, 2, 3, 4, 5};
     int size = sizeof(numbers) / sizeof(numbers[0]);
     int result = calculateSum(numbers, size);
     cout << "Sum in C++: " << result << endl;
+    cout << "Sum with reduce: " << sum(span<const int>(numbers)) << endl;
+
+    // --bench [N]: compare the original loop with sum() and parallelSum(),
+    // on a cache-resident array and on one of N elements. calculateSum is
+    // only run where its int total cannot overflow.
+    if (argc > 1 && strcmp(argv[1], "--bench") == 0) {
+        constexpr int maxValue = 999;
+        size_t largest = argc > 2 ? strtoull(argv[2], nullptr, 10) : size_t{1} << 24;
+        cout << "Threads: " << thread::hardware_concurrency() << endl;
+        for (size_t n : {min(largest, size_t{1} << 14), largest}) {
+            vector<int> values(n);
+            for (size_t i = 0; i < n; i++) {
+                values[i] = static_cast<int>(i % (maxValue + 1));
+            }
+            span<const int> all(values);
+            cout << "\nElements: " << n << endl;
+            cout << "sum (int64_t):      " << sum(all) << endl;
+            if (n <= static_cast<size_t>(INT_MAX / maxValue)) {
+                cout << "calculateSum (int): " << calculateSum(values.data(), static_cast<int>(n)) << endl;
+                benchmark("calculateSum", n, [&] { return calculateSum(values.data(), static_cast<int>(n)); });
+            } else {
+                cout << "calculateSum (int): skipped, the total may overflow int" << endl;
+            }
+            benchmark("sum", n, [&] { return sum(all); });
+            benchmark("parallelSum", n, [&] { return parallelSum(all); });
+        }
+    }
     return 0;
-}
\ No newline at end of file
+}
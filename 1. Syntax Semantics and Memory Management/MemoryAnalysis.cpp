@@ -2,11 +2,23 @@
 #include <vector>
 #include <memory>
 #include <string>
+#include <iomanip>
 
 /**
  * C++ Memory Management Analysis
  * Demonstrates manual memory management, RAII, and smart pointers
+ * Builds on its own:
+ *   g++ -std=c++17 MemoryAnalysis.cpp
+ * or with the allocation tracker linked in, to report what each example
+ * allocated and leaked:
+ *   g++ -std=c++17 -DALLOCATION_TRACKING MemoryAnalysis.cpp AllocationTracker.cpp
  */
+#if defined(ALLOCATION_TRACKING)
+#include "AllocationTracker.h"
+#define TRACK_ALLOCATIONS(label) AllocationScope scope(label)
+#else
+#define TRACK_ALLOCATIONS(label) ((void)0)
+#endif
 
 // Example 1: Manual memory management (traditional C++ approach)
 void manualMemoryManagement() {
@@ -122,19 +134,57 @@ int main() {
     std::cout << "C++ Memory Management Demonstration" << std::endl;
     std::cout << "===================================" << std::endl;
     
-    manualMemoryManagement();
+    // Each example's allocations are attributed to its own site
+    {
+        TRACK_ALLOCATIONS("manualMemoryManagement");
+        manualMemoryManagement();
+    }
     std::cout << std::endl;
     
-    raiiExample();
+    {
+        TRACK_ALLOCATIONS("raiiExample");
+        raiiExample();
+    }
     std::cout << std::endl;
     
-    smartPointerExample();
+    {
+        TRACK_ALLOCATIONS("smartPointerExample");
+        smartPointerExample();
+    }
     std::cout << std::endl;
     
-    memoryLeakExample();
+    {
+        TRACK_ALLOCATIONS("memoryLeakExample");
+        memoryLeakExample();
+    }
     std::cout << std::endl;
     
-    exceptionSafetyExample();
+    {
+        TRACK_ALLOCATIONS("exceptionSafetyExample");
+        exceptionSafetyExample();
+    }
+    
+    // Allocation tracking: what each example allocated, and what it leaked
+    std::cout << "\n=== Allocation Tracking ===" << std::endl;
+#if defined(ALLOCATION_TRACKING)
+    for (const AllocationSiteStats& site : AllocationTracker::sites()) {
+        if (site.labelled) {
+            std::cout << std::left << std::setw(24) << site.site << std::right << std::setw(4) << site.allocations
+                      << " allocations, " << std::setw(4) << site.bytesAllocated << " bytes, "
+                      << site.liveAllocations << " still live" << std::endl;
+        }
+    }
+    for (const AllocationSiteStats& site : AllocationTracker::leaks()) {
+        if (site.labelled) {
+            std::cout << "Leak detected in " << site.site << ": " << site.liveAllocations << " allocations ("
+                      << site.liveBytes << " bytes) never freed" << std::endl;
+        }
+    }
+    std::cout << "Peak RSS: " << AllocationTracker::peakRssKb() << " KiB" << std::endl;
+#else
+    std::cout << "Allocation tracking was compiled out (build with -DALLOCATION_TRACKING and AllocationTracker.cpp)"
+              << std::endl;
+#endif
     
     std::cout << "\nKey Features:" << std::endl;
     std::cout << "- Manual memory management (new/delete)" << std::endl;
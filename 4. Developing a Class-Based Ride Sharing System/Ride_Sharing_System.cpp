@@ -2,200 +2,5744 @@
 #include <vector>
 #include <string>
 #include <memory>
+#include <memory_resource>
 #include <iomanip>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <charconv>
+#include <compare>
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <functional>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <optional>
+#include <queue>
+#include <thread>
+#include <deque>
+#include <limits>
+#include <mutex>
+#include <set>
+#include <shared_mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+#include <variant>
+
+#include <fcntl.h>
+#include <linux/membarrier.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include "../common/IdGenerator.h"
+
+// Allocation profiling (--alloc-profile): build with -DRIDE_ALLOCATION_TRACKING
+// and link "../1. Syntax Semantics and Memory Management/AllocationTracker.cpp"
+#if defined(RIDE_ALLOCATION_TRACKING)
+#include "../1. Syntax Semantics and Memory Management/AllocationTracker.h"
+#endif
+
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+// Hot-path instrumentation; build with -DRIDE_METRICS=0 to compile it out
+#ifndef RIDE_METRICS
+#define RIDE_METRICS 1
+#endif
+
+// Closed set of ride types, used as a compact tag in columnar storage
+enum class RideType : std::uint8_t {
+    Standard,
+    Premium
+};
+
+constexpr size_t rideTypeCount = 2;
+
+// Display name of each ride type; returned as a view, so no allocation per call
+constexpr std::string_view rideTypeName(RideType type) {
+    return type == RideType::Premium ? "Premium" : "Standard";
+}
+
+// Pricing inputs shared by every ride of a given type
+struct FarePolicy {
+    double baseFareRate;
+    double luxuryMultiplier;
+};
+
+constexpr FarePolicy farePolicyFor(RideType type) {
+    return type == RideType::Premium ? FarePolicy{3.5, 1.8} : FarePolicy{2.0, 1.0};
+}
+
+// Money - exact amount in integer cents. A fare is rounded to the cent
+// once, when it is charged; from then on amounts only add and subtract
+// as integers, so totals do not depend on summation order or on how the
+// work is split across threads.
+class Money {
+private:
+    std::int64_t cents = 0;
+
+public:
+    constexpr Money() = default;
+    constexpr explicit Money(std::int64_t amountInCents) : cents(amountInCents) {}
+
+    // Nearest cent, halves away from zero
+    static Money fromDollars(double dollars) { return Money(std::llround(dollars * 100.0)); }
+
+    constexpr std::int64_t getCents() const { return cents; }
+    constexpr double toDollars() const { return static_cast<double>(cents) / 100.0; }
+
+    constexpr Money& operator+=(Money other) {
+        cents += other.cents;
+        return *this;
+    }
+    constexpr Money& operator-=(Money other) {
+        cents -= other.cents;
+        return *this;
+    }
+    friend constexpr Money operator+(Money a, Money b) { return a += b; }
+    friend constexpr Money operator-(Money a, Money b) { return a -= b; }
+    friend constexpr auto operator<=>(const Money&, const Money&) = default;
+};
+
+// Exact sum of amounts in cents. Integer addition is associative, so the
+// lanes and accumulators may be combined in any order and the result is
+// identical to a serial loop (and to any partitioning across threads).
+std::int64_t sumCents(std::span<const std::int64_t> cents) {
+    const std::size_t count = cents.size();
+    const std::int64_t* in = cents.data();
+    std::size_t i = 0;
+    std::int64_t total = 0;
+
+#if defined(__AVX512F__)
+    __m512i acc512 = _mm512_setzero_si512();
+    for (; i + 8 <= count; i += 8) {
+        acc512 = _mm512_add_epi64(acc512, _mm512_loadu_si512(in + i));
+    }
+    alignas(64) std::int64_t lanes512[8];
+    _mm512_store_si512(lanes512, acc512);
+    for (std::int64_t lane : lanes512) {
+        total += lane;
+    }
+#endif
+#if defined(__AVX2__)
+    __m256i acc256 = _mm256_setzero_si256();
+    for (; i + 4 <= count; i += 4) {
+        acc256 = _mm256_add_epi64(acc256, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i)));
+    }
+    alignas(32) std::int64_t lanes[4];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), acc256);
+    total += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    int64x2_t acc128 = vdupq_n_s64(0);
+    for (; i + 2 <= count; i += 2) {
+        acc128 = vaddq_s64(acc128, vld1q_s64(in + i));
+    }
+    total += vaddvq_s64(acc128);
+#endif
+    // Scalar fallback and tail
+    for (; i < count; ++i) {
+        total += in[i];
+    }
+    return total;
+}
+
+
+// ReportSink - destination for rendered reports
+class ReportSink {
+public:
+    virtual ~ReportSink() = default;
+    virtual void write(std::string_view bytes) = 0;
+};
+
+// Standard output, through std::cout so ordering with other console
+// output is preserved. One write and one flush per report.
+class ConsoleSink : public ReportSink {
+public:
+    void write(std::string_view bytes) override {
+        std::cout.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+        std::cout.flush();
+    }
+};
+
+// POSIX file descriptor sink: a file, pipe or connected socket
+class FdSink : public ReportSink {
+private:
+    int fd;
+    bool owned;
+
+public:
+    explicit FdSink(int descriptor, bool takeOwnership = false) : fd(descriptor), owned(takeOwnership) {}
+
+    // Opens (creating or truncating) a file for writing
+    explicit FdSink(const std::string& path)
+        : fd(::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644)), owned(true) {
+        if (fd < 0) {
+            throw std::system_error(errno, std::generic_category(), "FdSink: cannot open " + path);
+        }
+    }
+
+    ~FdSink() override {
+        if (owned) {
+            ::close(fd);
+        }
+    }
+
+    FdSink(const FdSink&) = delete;
+    FdSink& operator=(const FdSink&) = delete;
+
+    // Waits until everything written so far is on stable storage
+    void sync() {
+        if (::fsync(fd) != 0) {
+            throw std::system_error(errno, std::generic_category(), "FdSink: fsync failed");
+        }
+    }
+
+    void write(std::string_view bytes) override {
+        while (!bytes.empty()) {
+            ssize_t written = ::write(fd, bytes.data(), bytes.size());
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw std::system_error(errno, std::generic_category(), "FdSink: write failed");
+            }
+            bytes.remove_prefix(static_cast<size_t>(written));
+        }
+    }
+};
+
+// ReportWriter - formats a report into a reusable buffer
+// Numbers are formatted with std::to_chars (no locale, no stream state), and
+// the buffer keeps its capacity between reports, so steady-state rendering
+// does not allocate. flushTo() hands the whole report to a sink in a single
+// write() call.
+class ReportWriter {
+private:
+    std::string buffer;
+
+    template <typename... Args>
+    ReportWriter& format(Args... args) {
+        char digits[64];
+        auto result = std::to_chars(digits, digits + sizeof(digits), args...);
+        buffer.append(digits, result.ptr);
+        return *this;
+    }
+
+public:
+    ReportWriter& operator<<(std::string_view text) {
+        buffer.append(text);
+        return *this;
+    }
+    ReportWriter& operator<<(char c) {
+        buffer.push_back(c);
+        return *this;
+    }
+    ReportWriter& operator<<(int value) { return format(value); }
+    ReportWriter& operator<<(size_t value) { return format(value); }
+    ReportWriter& operator<<(std::int64_t value) { return format(value); }
+    // Shortest round-trip form, e.g. 4.8
+    ReportWriter& operator<<(double value) { return format(value); }
+
+    // Fixed-point with the given number of decimals, e.g. 31.00
+    ReportWriter& fixed(double value, int decimals = 2) {
+        return format(value, std::chars_format::fixed, decimals);
+    }
+
+    // Exact dollars and cents, e.g. 31.00
+    ReportWriter& operator<<(Money amount) {
+        std::int64_t cents = amount.getCents();
+        std::uint64_t magnitude = cents < 0 ? 0 - static_cast<std::uint64_t>(cents) : static_cast<std::uint64_t>(cents);
+        if (cents < 0) {
+            buffer.push_back('-');
+        }
+        format(magnitude / 100);
+        buffer.push_back('.');
+        buffer.push_back(static_cast<char>('0' + magnitude % 100 / 10));
+        buffer.push_back(static_cast<char>('0' + magnitude % 10));
+        return *this;
+    }
+
+    std::string_view view() const { return buffer; }
+    void clear() { buffer.clear(); }
+
+    void flushTo(ReportSink& sink) {
+        if (!buffer.empty()) {
+            sink.write(buffer);
+            buffer.clear();
+        }
+    }
+};
+
+// Shared console sink and writer used by the printing methods below
+inline ConsoleSink& consoleSink() {
+    static ConsoleSink sink;
+    return sink;
+}
+
+inline ReportWriter& consoleReport() {
+    thread_local ReportWriter writer;
+    return writer;
+}
+
+inline std::ostream& operator<<(std::ostream& os, Money amount) {
+    ReportWriter text;
+    text << amount;
+    return os << text.view();
+}
+
+#if RIDE_METRICS
+// Hot-path metrics. Each thread records into its own block with relaxed
+// load/store pairs (no shared cache lines, no locked read-modify-write);
+// a scrape merges every live block plus the totals of exited threads.
+// Counters are exact. Reading the clock costs more than a fare, so only
+// one in latencySampleInterval calls per thread is timed; the histograms'
+// _count is the number of samples, the matching _total counter the calls.
+enum class MetricCounter : std::uint8_t {
+    RidesCreated,
+    RidesAssigned,
+    RidesRequested,
+    FaresComputed
+};
+
+enum class MetricLatency : std::uint8_t {
+    RideCreation,
+    RideAssignment,
+    RideRequest,
+    FareComputation
+};
+
+constexpr size_t metricCounterCount = 4;
+constexpr size_t metricLatencyCount = 4;
+constexpr std::uint32_t latencySampleInterval = 16;
+
+struct MetricInfo {
+    std::string_view name;
+    std::string_view help;
+};
+
+constexpr std::array<MetricInfo, metricCounterCount> counterInfo{{
+    {"ride_rides_created_total", "Rides constructed, however allocated"},
+    {"ride_rides_assigned_total", "Rides assigned to drivers"},
+    {"ride_rides_requested_total", "Rides requested by riders"},
+    {"ride_fares_computed_total", "Fares computed (memo misses, store lookups and batch rows)"},
+}};
+
+constexpr std::array<MetricInfo, metricLatencyCount> latencyInfo{{
+    {"ride_creation_seconds", "Time to allocate and construct a ride through RideArena or makeRide"},
+    {"ride_assignment_seconds", "Time spent in Driver::addRide"},
+    {"ride_request_seconds", "Time spent in Rider::requestRide, excluding console output"},
+    {"ride_fare_computation_seconds", "Time to compute an uncached fare"},
+}};
+
+// LatencyHistogram - HDR-style log-linear histogram of nanosecond values.
+// Values up to 16 are exact; above that every power of two is split into
+// 16 linear sub-buckets, so a value is known to within 6.25%. Buckets are
+// upper-inclusive, (previous edge, upperBound], so the cumulative "le"
+// counts exported at power-of-two bounds are exact.
+class LatencyHistogram {
+private:
+    // Edge between bucket - 1 and bucket in the log-linear layout
+    static std::uint64_t edge(size_t bucket) {
+        if (bucket < subBuckets) {
+            return bucket;
+        }
+        size_t shift = bucket / subBuckets - 1;
+        return (subBuckets + bucket % subBuckets) << shift;
+    }
+
+public:
+    static constexpr unsigned subBucketBits = 4;
+    static constexpr unsigned maxExponent = 40; // ~18 minutes; larger values clamp
+    static constexpr size_t subBuckets = size_t{1} << subBucketBits;
+    static constexpr size_t bucketCount = (maxExponent - subBucketBits + 1) * subBuckets;
+
+    static size_t bucketOf(std::uint64_t nanos) {
+        // Laid out on nanos - 1, so a value on an edge closes the bucket below it
+        std::uint64_t offset = std::min(nanos == 0 ? 0 : nanos - 1, (std::uint64_t{1} << maxExponent) - 1);
+        if (offset < subBuckets) {
+            return static_cast<size_t>(offset);
+        }
+        unsigned shift = static_cast<unsigned>(std::bit_width(offset)) - 1 - subBucketBits;
+        return (shift + 1) * subBuckets + static_cast<size_t>((offset >> shift) - subBuckets);
+    }
+
+    // Largest value that falls in the bucket
+    static std::uint64_t upperBound(size_t bucket) { return edge(bucket + 1); }
+
+    std::array<std::uint64_t, bucketCount> counts{};
+    std::uint64_t count = 0;
+    std::uint64_t sumNanos = 0;
+
+    void merge(const LatencyHistogram& other) {
+        for (size_t i = 0; i < bucketCount; ++i) {
+            counts[i] += other.counts[i];
+        }
+        count += other.count;
+        sumNanos += other.sumNanos;
+    }
+
+    // Number of recorded values less than or equal to bound (exact when
+    // bound is a bucket's upper bound, e.g. any power of two)
+    std::uint64_t countAtMost(std::uint64_t bound) const {
+        std::uint64_t atMost = 0;
+        for (size_t i = 0; i < bucketCount && upperBound(i) <= bound; ++i) {
+            atMost += counts[i];
+        }
+        return atMost;
+    }
+
+    // Upper edge of the bucket holding the q-th quantile (0 < q <= 1)
+    std::uint64_t percentile(double q) const {
+        auto rank = static_cast<std::uint64_t>(std::ceil(q * static_cast<double>(count)));
+        std::uint64_t seen = 0;
+        for (size_t i = 0; i < bucketCount; ++i) {
+            seen += counts[i];
+            if (seen >= rank && counts[i] != 0) {
+                return upperBound(i);
+            }
+        }
+        return 0;
+    }
+};
+
+struct MetricsSnapshot {
+    std::array<std::uint64_t, metricCounterCount> counters{};
+    std::array<LatencyHistogram, metricLatencyCount> latencies{};
+};
+
+// MetricsRegistry - owner of the per-thread blocks and the scrape path
+class MetricsRegistry {
+private:
+    template <typename T>
+    static void bump(std::atomic<T>& cell, T amount) {
+        // Single writer per block, so no read-modify-write is needed
+        cell.store(cell.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+    }
+
+    struct ThreadBlock {
+        std::array<std::atomic<std::uint64_t>, metricCounterCount> counters{};
+        struct Histogram {
+            std::array<std::atomic<std::uint64_t>, LatencyHistogram::bucketCount> counts{};
+            std::atomic<std::uint64_t> count{0};
+            std::atomic<std::uint64_t> sumNanos{0};
+        };
+        std::array<Histogram, metricLatencyCount> latencies{};
+        std::array<std::uint32_t, metricLatencyCount> untilSample{}; // Owner thread only
+
+        void addTo(MetricsSnapshot& out) const {
+            for (size_t c = 0; c < metricCounterCount; ++c) {
+                out.counters[c] += counters[c].load(std::memory_order_relaxed);
+            }
+            for (size_t l = 0; l < metricLatencyCount; ++l) {
+                LatencyHistogram& merged = out.latencies[l];
+                for (size_t i = 0; i < LatencyHistogram::bucketCount; ++i) {
+                    merged.counts[i] += latencies[l].counts[i].load(std::memory_order_relaxed);
+                }
+                merged.count += latencies[l].count.load(std::memory_order_relaxed);
+                merged.sumNanos += latencies[l].sumNanos.load(std::memory_order_relaxed);
+            }
+        }
+    };
+
+    // Enrolls the calling thread's block on first use and folds it into
+    // the retired totals when the thread exits
+    struct Registration {
+        ThreadBlock block;
+        Registration() {
+            MetricsRegistry& registry = shared();
+            std::lock_guard<std::mutex> lock(registry.mutex);
+            registry.live.push_back(&block);
+        }
+        ~Registration() {
+            MetricsRegistry& registry = shared();
+            std::lock_guard<std::mutex> lock(registry.mutex);
+            block.addTo(registry.retired);
+            registry.live.erase(std::find(registry.live.begin(), registry.live.end(), &block));
+        }
+    };
+
+    std::mutex mutex; // Guards live and retired; never taken on the hot path
+    std::vector<const ThreadBlock*> live;
+    MetricsSnapshot retired;
+
+    static ThreadBlock& local() {
+        thread_local Registration registration;
+        return registration.block;
+    }
+
+public:
+    static MetricsRegistry& shared() {
+        static MetricsRegistry registry;
+        return registry;
+    }
+
+    static void count(MetricCounter counter, std::uint64_t amount = 1) {
+        bump(local().counters[static_cast<size_t>(counter)], amount);
+    }
+
+    // True for the first and then every latencySampleInterval-th call
+    static bool shouldSample(MetricLatency latency) {
+        std::uint32_t& countdown = local().untilSample[static_cast<size_t>(latency)];
+        if (countdown != 0) {
+            --countdown;
+            return false;
+        }
+        countdown = latencySampleInterval - 1;
+        return true;
+    }
+
+    static void record(MetricLatency latency, std::uint64_t nanos) {
+        ThreadBlock::Histogram& histogram = local().latencies[static_cast<size_t>(latency)];
+        bump(histogram.counts[LatencyHistogram::bucketOf(nanos)], std::uint64_t{1});
+        bump(histogram.count, std::uint64_t{1});
+        bump(histogram.sumNanos, nanos);
+    }
+
+    // Merged view over every thread that has recorded so far
+    std::unique_ptr<MetricsSnapshot> snapshot() {
+        auto merged = std::make_unique<MetricsSnapshot>();
+        std::lock_guard<std::mutex> lock(mutex);
+        *merged = retired;
+        for (const ThreadBlock* block : live) {
+            block->addTo(*merged);
+        }
+        return merged;
+    }
+
+    // Prometheus text exposition format. Histogram buckets are exported at
+    // power-of-two nanosecond bounds from 32 ns to ~1 s.
+    void renderPrometheus(ReportWriter& out) {
+        std::unique_ptr<MetricsSnapshot> merged = snapshot();
+        for (size_t c = 0; c < metricCounterCount; ++c) {
+            out << "# HELP " << counterInfo[c].name << ' ' << counterInfo[c].help << '\n';
+            out << "# TYPE " << counterInfo[c].name << " counter\n";
+            out << counterInfo[c].name << ' ' << static_cast<size_t>(merged->counters[c]) << '\n';
+        }
+        for (size_t l = 0; l < metricLatencyCount; ++l) {
+            const MetricInfo& info = latencyInfo[l];
+            const LatencyHistogram& histogram = merged->latencies[l];
+            out << "# HELP " << info.name << ' ' << info.help << '\n';
+            out << "# TYPE " << info.name << " histogram\n";
+            for (unsigned exponent = 5; exponent <= 30; ++exponent) {
+                std::uint64_t bound = std::uint64_t{1} << exponent;
+                out << info.name << "_bucket{le=\"" << static_cast<double>(bound) / 1e9 << "\"} "
+                    << static_cast<size_t>(histogram.countAtMost(bound)) << '\n';
+            }
+            out << info.name << "_bucket{le=\"+Inf\"} " << static_cast<size_t>(histogram.count) << '\n';
+            out << info.name << "_sum " << static_cast<double>(histogram.sumNanos) / 1e9 << '\n';
+            out << info.name << "_count " << static_cast<size_t>(histogram.count) << '\n';
+        }
+    }
+};
+
+// Records the lifetime of the enclosing scope into a latency histogram
+// (when this call is sampled)
+class ScopedLatency {
+private:
+    MetricLatency latency;
+    bool sampled;
+    std::chrono::steady_clock::time_point start;
+
+public:
+    explicit ScopedLatency(MetricLatency metric) : latency(metric), sampled(MetricsRegistry::shouldSample(metric)) {
+        if (sampled) {
+            start = std::chrono::steady_clock::now();
+        }
+    }
+    ~ScopedLatency() {
+        if (!sampled) {
+            return;
+        }
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        MetricsRegistry::record(latency, static_cast<std::uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+    }
+
+    ScopedLatency(const ScopedLatency&) = delete;
+    ScopedLatency& operator=(const ScopedLatency&) = delete;
+};
+
+#define RIDE_METRIC_COUNT(counter, amount) MetricsRegistry::count(MetricCounter::counter, amount)
+#define RIDE_METRIC_CONCAT_(a, b) a##b
+#define RIDE_METRIC_CONCAT(a, b) RIDE_METRIC_CONCAT_(a, b)
+// Each use declares a uniquely named scope, so several timings can share a block
+#define RIDE_METRIC_TIME(latency) ScopedLatency RIDE_METRIC_CONCAT(rideMetricScope, __COUNTER__)(MetricLatency::latency)
+#else
+#define RIDE_METRIC_COUNT(counter, amount) ((void)0)
+#define RIDE_METRIC_TIME(latency) ((void)0)
+#endif
+
+// Batch fare kernel for rides of a single type:
+// out[i] = distances[i] * baseFareRate * luxuryMultiplier
+// The two multiplies are kept separate (rather than folding the constants)
+// so results are bit-identical to the per-ride fare() methods.
+void computeFares(std::span<const double> distances, RideType type, std::span<double> out) {
+    if (out.size() < distances.size()) {
+        throw std::invalid_argument("computeFares: output span is smaller than input");
+    }
+    const FarePolicy policy = farePolicyFor(type);
+    const std::size_t count = distances.size();
+    RIDE_METRIC_COUNT(FaresComputed, count);
+    const double* in = distances.data();
+    double* dst = out.data();
+    std::size_t i = 0;
+
+#if defined(__AVX512F__)
+    const __m512d rate512 = _mm512_set1_pd(policy.baseFareRate);
+    const __m512d multiplier512 = _mm512_set1_pd(policy.luxuryMultiplier);
+    for (; i + 8 <= count; i += 8) {
+        __m512d d = _mm512_loadu_pd(in + i);
+        _mm512_storeu_pd(dst + i, _mm512_mul_pd(_mm512_mul_pd(d, rate512), multiplier512));
+    }
+#endif
+#if defined(__AVX2__)
+    const __m256d rate256 = _mm256_set1_pd(policy.baseFareRate);
+    const __m256d multiplier256 = _mm256_set1_pd(policy.luxuryMultiplier);
+    for (; i + 4 <= count; i += 4) {
+        __m256d d = _mm256_loadu_pd(in + i);
+        _mm256_storeu_pd(dst + i, _mm256_mul_pd(_mm256_mul_pd(d, rate256), multiplier256));
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    const float64x2_t rate128 = vdupq_n_f64(policy.baseFareRate);
+    const float64x2_t multiplier128 = vdupq_n_f64(policy.luxuryMultiplier);
+    for (; i + 2 <= count; i += 2) {
+        float64x2_t d = vld1q_f64(in + i);
+        vst1q_f64(dst + i, vmulq_f64(vmulq_f64(d, rate128), multiplier128));
+    }
+#endif
+    // Scalar fallback and tail
+    for (; i < count; ++i) {
+        dst[i] = in[i] * policy.baseFareRate * policy.luxuryMultiplier;
+    }
+}
+
+// Planar map coordinates in miles
+struct GeoPoint {
+    double x = 0.0;
+    double y = 0.0;
+};
+
+inline double squaredDistance(GeoPoint a, GeoPoint b) {
+    double dx = a.x - b.x;
+    double dy = a.y - b.y;
+    return dx * dx + dy * dy;
+}
+
+// LocationTable - string interner for pickup/dropoff names
+// Rides reference a few thousand distinct locations, so each ride stores two
+// 32-bit ids instead of two owned strings. Safe to use from multiple threads.
+// Entries live in fixed-size chunks that are never moved or freed, so views
+// returned by name() stay valid for the lifetime of the table, and lookups
+// (name, point, zone, and intern of a known name) take no lock: they read
+// the entry count and an open-addressing id index, both published with
+// release stores. Only an intern miss and a move take the writers' mutex. Index tables replaced by a larger one are kept, since a
+// reader may still be probing them; they total less than the live one.
+using LocationId = std::uint32_t;
+
+class LocationTable {
+private:
+    static constexpr unsigned chunkBits = 12;
+    static constexpr size_t chunkSize = size_t{1} << chunkBits;
+    static constexpr size_t maxChunks = size_t{1} << 14; // 2^26 locations
+
+    struct Entry {
+        std::string name;
+        // Seqlock over x and y: odd while a move is being written
+        std::atomic<std::uint32_t> pointVersion{0};
+        std::atomic<double> x{0.0};
+        std::atomic<double> y{0.0};
+        std::atomic<std::uint16_t> zone{0}; // Surge pricing zone
+    };
+
+    // Open-addressing name -> id index; slots hold id + 1, 0 when empty
+    struct IdIndex {
+        size_t mask;
+        std::unique_ptr<std::atomic<std::uint32_t>[]> slots;
+
+        explicit IdIndex(size_t capacity) : mask(capacity - 1), slots(new std::atomic<std::uint32_t>[capacity]) {
+            for (size_t i = 0; i < capacity; ++i) {
+                slots[i].store(0, std::memory_order_relaxed);
+            }
+        }
+    };
+
+    std::array<std::unique_ptr<Entry[]>, maxChunks> chunks; // Written before count publishes them
+    std::atomic<std::uint32_t> count{0};
+    std::atomic<const IdIndex*> index{nullptr};
+    std::vector<std::unique_ptr<IdIndex>> indexes; // Live one last
+    std::mutex mutex; // Writers only
+
+    Entry& slot(LocationId id) const { return chunks[id >> chunkBits][id & (chunkSize - 1)]; }
+
+    const Entry& entry(LocationId id) const {
+        if (id >= count.load(std::memory_order_acquire)) {
+            throw std::out_of_range("LocationTable: unknown location id");
+        }
+        return slot(id);
+    }
+
+    std::optional<LocationId> find(std::string_view name) const {
+        const IdIndex* table = index.load(std::memory_order_acquire);
+        if (table == nullptr) {
+            return std::nullopt;
+        }
+        for (size_t i = std::hash<std::string_view>{}(name) & table->mask;; i = (i + 1) & table->mask) {
+            std::uint32_t stored = table->slots[i].load(std::memory_order_acquire);
+            if (stored == 0) {
+                return std::nullopt;
+            }
+            if (slot(stored - 1).name == name) {
+                return stored - 1;
+            }
+        }
+    }
+
+    // Caller holds mutex; the entry for id is fully written
+    static void place(IdIndex& table, std::string_view name, LocationId id) {
+        size_t i = std::hash<std::string_view>{}(name) & table.mask;
+        while (table.slots[i].load(std::memory_order_relaxed) != 0) {
+            i = (i + 1) & table.mask;
+        }
+        table.slots[i].store(id + 1, std::memory_order_release);
+    }
+
+public:
+    LocationTable() = default;
+    LocationTable(const LocationTable&) = delete;
+    LocationTable& operator=(const LocationTable&) = delete;
+
+    // Returns the id of name, adding it on first use
+    LocationId intern(std::string_view name) {
+        if (std::optional<LocationId> known = find(name)) {
+            return *known;
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        if (std::optional<LocationId> known = find(name)) { // Another writer may have added it meanwhile
+            return *known;
+        }
+        const LocationId id = count.load(std::memory_order_relaxed);
+        if (id >= chunkSize * maxChunks) {
+            throw std::length_error("LocationTable: too many distinct locations");
+        }
+        if ((id & (chunkSize - 1)) == 0) {
+            chunks[id >> chunkBits] = std::make_unique<Entry[]>(chunkSize);
+        }
+        slot(id).name = name;
+        count.store(id + 1, std::memory_order_release);
+
+        // Keep the index at most half full; a grown index is filled before
+        // it is published
+        const IdIndex* live = index.load(std::memory_order_relaxed);
+        if (live == nullptr || (static_cast<size_t>(id) + 1) * 2 > live->mask + 1) {
+            auto grown = std::make_unique<IdIndex>(live == nullptr ? 64 : (live->mask + 1) * 2);
+            for (LocationId existing = 0; existing <= id; ++existing) {
+                place(*grown, slot(existing).name, existing);
+            }
+            index.store(grown.get(), std::memory_order_release);
+            indexes.push_back(std::move(grown));
+        } else {
+            place(*indexes.back(), name, id);
+        }
+        return id;
+    }
+
+    // Interns name and records (or moves) its map coordinates
+    LocationId intern(std::string_view name, GeoPoint point) {
+        LocationId id = intern(name);
+        Entry& target = slot(id);
+        std::lock_guard<std::mutex> lock(mutex);
+        std::uint32_t version = target.pointVersion.load(std::memory_order_relaxed);
+        target.pointVersion.store(version + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        target.x.store(point.x, std::memory_order_relaxed);
+        target.y.store(point.y, std::memory_order_relaxed);
+        target.pointVersion.store(version + 2, std::memory_order_release);
+        return id;
+    }
+
+    std::string_view name(LocationId id) const { return entry(id).name; }
+
+    GeoPoint point(LocationId id) const {
+        const Entry& source = entry(id);
+        for (;;) {
+            std::uint32_t version = source.pointVersion.load(std::memory_order_acquire);
+            GeoPoint point{source.x.load(std::memory_order_relaxed), source.y.load(std::memory_order_relaxed)};
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if ((version & 1) == 0 && source.pointVersion.load(std::memory_order_relaxed) == version) {
+                return point;
+            }
+        }
+    }
+
+    // Surge pricing zone of a location (0 unless assigned)
+    void setZone(LocationId id, std::uint16_t zone) {
+        entry(id); // Bounds check
+        slot(id).zone.store(zone, std::memory_order_relaxed);
+    }
+
+    std::uint16_t zone(LocationId id) const { return entry(id).zone.load(std::memory_order_relaxed); }
+
+    size_t size() const { return count.load(std::memory_order_acquire); }
+
+    // Process-wide table used by Ride
+    static LocationTable& shared() {
+        static LocationTable table;
+        return table;
+    }
+};
+
+// EpochDomain - epoch-based reclamation for objects that lock-free readers
+// may still be reading after a writer has replaced them (surge tables,
+// driver and rider snapshots).
+// A reader pins the current epoch with an EpochGuard while it reads; a
+// writer that unlinks an object retire()s it, tagged with the epoch at that
+// moment. Collection advances the epoch and frees everything retired before
+// the oldest pinned epoch, so an object is freed only after every reader
+// that could have loaded it has unpinned. Readers never lock or wait, and
+// writers never wait for readers either; a stalled reader only delays
+// frees.
+// Pinning is a plain store to a per-thread slot. The store-load fence it
+// needs is paid by the collector instead, with one process-wide
+// membarrier() per collection (readers only fall back to a fence when the
+// kernel lacks it), and retired objects are batched per thread, so neither
+// side takes a lock per object.
+class EpochDomain {
+private:
+    static constexpr std::uint64_t unpinned = std::numeric_limits<std::uint64_t>::max();
+    static constexpr size_t minBatch = 128; // Retires per thread between collections
+
+    struct Retired {
+        const void* object;
+        void (*destroy)(const void*);
+        std::uint64_t epoch;
+    };
+
+    // Enrolls the calling thread's reader slot on first use; when the
+    // thread exits its unfreed retirees are handed to the next collection
+    struct Registration {
+        std::atomic<std::uint64_t> epoch{unpinned}; // Written by the owner thread only
+        std::vector<Retired> batch;                 // Owner thread only
+        size_t collectAt = minBatch;
+        Registration() {
+            EpochDomain& domain = shared();
+            std::lock_guard<std::mutex> lock(domain.mutex);
+            domain.readers.push_back(this);
+        }
+        ~Registration() {
+            EpochDomain& domain = shared();
+            std::lock_guard<std::mutex> lock(domain.mutex);
+            domain.readers.erase(std::find(domain.readers.begin(), domain.readers.end(), this));
+            domain.orphans.insert(domain.orphans.end(), batch.begin(), batch.end());
+        }
+    };
+
+    std::atomic<std::uint64_t> globalEpoch{1};
+    bool asymmetricFence = false; // Set once, before any reader runs
+    std::mutex mutex; // Guards readers, orphans and freed; readers never take it
+    std::vector<const Registration*> readers;
+    std::vector<Retired> orphans;
+    std::uint64_t freed = 0;
+
+    friend class EpochGuard;
+
+    EpochDomain() {
+        asymmetricFence = ::syscall(SYS_membarrier, MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED, 0, 0) == 0;
+    }
+
+    static Registration& local() {
+        thread_local Registration registration;
+        return registration;
+    }
+
+    // Frees the entries of pending that no pinned reader can hold
+    static size_t freeExpired(std::vector<Retired>& pending, std::uint64_t oldest) {
+        auto expired = std::partition(pending.begin(), pending.end(),
+                                      [oldest](const Retired& entry) { return entry.epoch >= oldest; });
+        for (auto it = expired; it != pending.end(); ++it) {
+            it->destroy(it->object);
+        }
+        size_t count = static_cast<size_t>(pending.end() - expired);
+        pending.erase(expired, pending.end());
+        return count;
+    }
+
+    // Advances the epoch and frees what has expired from the calling
+    // thread's batch and from exited threads' leftovers
+    void collect(Registration& self) {
+        std::vector<Retired> adopted;
+        std::uint64_t oldest = unpinned;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            globalEpoch.fetch_add(1, std::memory_order_seq_cst);
+            // Every reader's pin store is visible after this
+            if (asymmetricFence) {
+                ::syscall(SYS_membarrier, MEMBARRIER_CMD_PRIVATE_EXPEDITED, 0, 0);
+            }
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            for (const Registration* reader : readers) {
+                oldest = std::min(oldest, reader->epoch.load(std::memory_order_acquire));
+            }
+            adopted.swap(orphans);
+        }
+        self.batch.insert(self.batch.end(), adopted.begin(), adopted.end());
+        size_t count = freeExpired(self.batch, oldest);
+        // Grow the trigger with what a pinned reader is holding back, so a
+        // stalled reader does not turn every retire into a full scan
+        self.collectAt = std::max(minBatch, self.batch.size() * 2);
+        std::lock_guard<std::mutex> lock(mutex);
+        freed += count;
+    }
+
+public:
+    ~EpochDomain() {
+        for (const Retired& entry : orphans) {
+            entry.destroy(entry.object);
+        }
+    }
+
+    EpochDomain(const EpochDomain&) = delete;
+    EpochDomain& operator=(const EpochDomain&) = delete;
+
+    // Hands object (already unreachable for new readers) to the domain,
+    // which deletes it once no pinned reader can still hold it. The tag is
+    // a seq_cst load, after the seq_cst store that unlinked the object, so
+    // a reader that pins any later epoch is ordered after that store.
+    // Destructors of retired objects must not retire.
+    template <typename T>
+    void retire(const T* object) {
+        if (object == nullptr) {
+            return;
+        }
+        Registration& self = local();
+        self.batch.push_back({object, [](const void* erased) { delete static_cast<const T*>(erased); },
+                              globalEpoch.load(std::memory_order_seq_cst)});
+        if (self.batch.size() >= self.collectAt) {
+            collect(self);
+        }
+    }
+
+    // Frees whatever no reader can still hold of this thread's retirees
+    // (and exited threads'). Optional: retire() collects on its own; this
+    // is for releasing memory at a known idle point.
+    void collect() { collect(local()); }
+
+    // Retired by this thread and not yet freed
+    size_t getPendingCount() { return local().batch.size(); }
+
+    std::uint64_t getFreedCount() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return freed;
+    }
+
+    static EpochDomain& shared() {
+        static EpochDomain domain;
+        return domain;
+    }
+};
+
+// EpochGuard - pins the calling thread for the guard's lifetime; objects
+// read from an EpochDomain-managed pointer stay valid until it is
+// destroyed. Guards nest, and only the outermost one pins, so a batch can
+// pin once around many lookups that each take their own guard.
+class EpochGuard {
+private:
+    EpochDomain::Registration& reader;
+    bool outermost;
+
+public:
+    // Nesting is read off the slot itself rather than a depth counter, so
+    // back-to-back guards do not chain through a read-modify-write
+    EpochGuard()
+        : reader(EpochDomain::local()),
+          outermost(reader.epoch.load(std::memory_order_relaxed) == EpochDomain::unpinned) {
+        if (outermost) {
+            EpochDomain& domain = EpochDomain::shared();
+            reader.epoch.store(domain.globalEpoch.load(std::memory_order_seq_cst), std::memory_order_relaxed);
+            // The pin must be visible before any protected pointer is
+            // loaded; with membarrier the collector enforces that
+            if (domain.asymmetricFence) {
+                std::atomic_signal_fence(std::memory_order_seq_cst);
+            } else {
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+            }
+        }
+    }
+
+    ~EpochGuard() {
+        if (outermost) {
+            reader.epoch.store(EpochDomain::unpinned, std::memory_order_release);
+        }
+    }
+
+    EpochGuard(const EpochGuard&) = delete;
+    EpochGuard& operator=(const EpochGuard&) = delete;
+};
+
+// Versioned - copy-on-write cell holding an immutable T. Readers get the
+// current version under an EpochGuard with a single load and see it
+// whole, however many times the writer publishes meanwhile. publish()
+// swaps in a complete new version and retires the old one to the shared
+// EpochDomain. The owner must outlive its readers, so the last version is
+// freed directly.
+template <typename T>
+class Versioned {
+private:
+    std::atomic<const T*> current;
+
+public:
+    explicit Versioned(T initial = T()) : current(new T(std::move(initial))) {}
+
+    ~Versioned() { delete current.load(std::memory_order_acquire); }
+
+    Versioned(const Versioned&) = delete;
+    Versioned& operator=(const Versioned&) = delete;
+
+    // Valid while guard is alive. seq_cst here and in publish() orders the
+    // pointer against the epoch tags (and costs nothing extra on x86).
+    const T& read(const EpochGuard&) const { return *current.load(std::memory_order_seq_cst); }
+
+    void publish(T next) {
+        const T* previous = current.exchange(new T(std::move(next)), std::memory_order_seq_cst);
+        EpochDomain::shared().retire(previous);
+    }
+};
+
+// SurgeTable - immutable multiplier grid indexed by pricing zone and time
+// bucket (e.g. hour of week). Lookups outside the grid are 1.0.
+using ZoneId = std::uint16_t;
+using TimeBucket = std::uint16_t;
+
+class SurgeTable {
+private:
+    size_t zoneCount;
+    size_t bucketCount;
+    std::vector<double> multipliers; // Row-major: zone * bucketCount + bucket
+    std::uint64_t version = 0;
+
+    friend class SurgePricing;
+
+public:
+    // Neutral table: every lookup is 1.0
+    SurgeTable() : zoneCount(0), bucketCount(0) {}
+
+    SurgeTable(size_t zones, size_t buckets, std::vector<double> values)
+        : zoneCount(zones), bucketCount(buckets), multipliers(std::move(values)) {
+        if (multipliers.size() != zones * buckets) {
+            throw std::invalid_argument("SurgeTable: expected zones * buckets multipliers");
+        }
+    }
+
+    double multiplier(ZoneId zone, TimeBucket bucket) const {
+        if (zone >= zoneCount || bucket >= bucketCount) {
+            return 1.0;
+        }
+        return multipliers[static_cast<size_t>(zone) * bucketCount + bucket];
+    }
+
+    std::uint64_t getVersion() const { return version; }
+    bool isNeutral() const { return multipliers.empty(); }
+};
+
+// SurgePricing - read-optimized, RCU-style holder of the current SurgeTable
+// It prices new rides: a ride takes its multiplier from the table current
+// when it is created and keeps it, so publishing a table never reprices
+// rides already taken.
+// Readers pin an epoch and do a single load of the table pointer,
+// with no lock and no shared write. The pricing service builds a complete
+// new table and publish() swaps it in atomically; readers see either the
+// old or the new table, never a mix. Replaced tables are retired to the
+// EpochDomain, which frees each once the last reader that could see it
+// has unpinned.
+class SurgePricing {
+private:
+    Versioned<SurgeTable> table;
+    std::mutex writerMutex; // Serializes publishers only
+    std::uint64_t nextVersion = 1;
+
+public:
+    SurgePricing() = default;
+
+    SurgePricing(const SurgePricing&) = delete;
+    SurgePricing& operator=(const SurgePricing&) = delete;
+
+    // Hot path: lock-free lookup in the current table
+    double multiplier(ZoneId zone, TimeBucket bucket) const {
+        EpochGuard guard;
+        return table.read(guard).multiplier(zone, bucket);
+    }
+
+    std::uint64_t getVersion() const {
+        EpochGuard guard;
+        return table.read(guard).getVersion();
+    }
+
+    // Consistent snapshot for batch work; valid while guard is alive
+    const SurgeTable& current(const EpochGuard& guard) const { return table.read(guard); }
+
+    void publish(SurgeTable next) {
+        std::lock_guard<std::mutex> lock(writerMutex);
+        next.version = nextVersion++;
+        table.publish(std::move(next));
+    }
+
+    // Process-wide instance; each Ride quotes its multiplier from it once,
+    // when created
+    static SurgePricing& shared() {
+        static SurgePricing pricing;
+        return pricing;
+    }
+};
+
+// Sources of ride, driver and rider IDs. Each thread draws from its own
+// block of the shared sequence, so concurrent producers do not contend per ID.
+inline IdSequence& rideIDSequence() {
+    static IdSequence sequence(1);
+    return sequence;
+}
+
+inline IdSequence& driverIDSequence() {
+    static IdSequence sequence(101);
+    return sequence;
+}
+
+inline IdSequence& riderIDSequence() {
+    static IdSequence sequence(201);
+    return sequence;
+}
+
+inline int nextRideID() {
+    thread_local IdGenerator generate(rideIDSequence());
+    return generate();
+}
+
+inline int nextDriverID() {
+    thread_local IdGenerator generate(driverIDSequence());
+    return generate();
+}
+
+inline int nextRiderID() {
+    thread_local IdGenerator generate(riderIDSequence());
+    return generate();
+}
+
+// RefCounted - reference count embedded in an object for IntrusivePtr.
+// Copying an object does not copy its owners, so a copy starts at zero.
+class RefCounted {
+private:
+    mutable std::atomic<std::uint32_t> references{0};
+
+    template <typename T, typename Policy>
+    friend class IntrusivePtr;
+
+protected:
+    RefCounted() = default;
+    RefCounted(const RefCounted&) noexcept {}
+    RefCounted& operator=(const RefCounted&) noexcept { return *this; }
+    ~RefCounted() = default;
+
+public:
+    std::uint32_t getUseCount() const { return references.load(std::memory_order_relaxed); }
+};
+
+// Reference-count policies for IntrusivePtr. Every handle to one object
+// must use the same policy.
+// AtomicRefCount: handles may be copied and dropped on any thread.
+struct AtomicRefCount {
+    static void increment(std::atomic<std::uint32_t>& count) noexcept {
+        count.fetch_add(1, std::memory_order_relaxed);
+    }
+    // True when the last reference was dropped; acq_rel so the deleting
+    // thread sees every other owner's writes
+    static bool decrement(std::atomic<std::uint32_t>& count) noexcept {
+        return count.fetch_sub(1, std::memory_order_acq_rel) == 1;
+    }
+};
+
+// LocalRefCount: all handles stay on one thread. Plain loads and stores,
+// so no locked read-modify-write instruction is issued.
+struct LocalRefCount {
+    static void increment(std::atomic<std::uint32_t>& count) noexcept {
+        count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+    static bool decrement(std::atomic<std::uint32_t>& count) noexcept {
+        std::uint32_t left = count.load(std::memory_order_relaxed) - 1;
+        count.store(left, std::memory_order_relaxed);
+        return left == 0;
+    }
+};
+
+// IntrusivePtr - shared ownership through the count embedded in T (a
+// RefCounted), so a handle is one pointer and there is no separate control
+// block. The object is deleted with delete when the last handle goes, so it
+// must come from new (see makeIntrusive); arena rides stay owned by their
+// RideStore.
+template <typename T, typename Policy = AtomicRefCount>
+class IntrusivePtr;
+
+template <typename T, typename Policy = AtomicRefCount, typename... Args>
+IntrusivePtr<T, Policy> makeIntrusive(Args&&... args);
+
+template <typename T, typename Policy>
+class IntrusivePtr {
+private:
+    T* object = nullptr;
+
+    template <typename U, typename P>
+    friend class IntrusivePtr;
+
+    template <typename U, typename P, typename... Args>
+    friend IntrusivePtr<U, P> makeIntrusive(Args&&... args);
+
+    // Takes the first reference to an object no other thread can see yet
+    struct FirstReference {};
+    IntrusivePtr(T* pointer, FirstReference) noexcept : object(pointer) {
+        object->references.store(1, std::memory_order_relaxed);
+    }
+
+public:
+    IntrusivePtr() = default;
+
+    // Adopts object; other handles to it may already exist
+    explicit IntrusivePtr(T* pointer) noexcept : object(pointer) {
+        if (object != nullptr) {
+            Policy::increment(object->references);
+        }
+    }
+
+    IntrusivePtr(const IntrusivePtr& other) noexcept : IntrusivePtr(other.object) {}
+    IntrusivePtr(IntrusivePtr&& other) noexcept : object(std::exchange(other.object, nullptr)) {}
+
+    // Upcast, e.g. IntrusivePtr<PremiumRide> to IntrusivePtr<Ride>
+    template <typename U, typename = std::enable_if_t<std::is_convertible_v<U*, T*>>>
+    IntrusivePtr(IntrusivePtr<U, Policy> other) noexcept : object(std::exchange(other.object, nullptr)) {}
+
+    IntrusivePtr& operator=(IntrusivePtr other) noexcept {
+        std::swap(object, other.object);
+        return *this;
+    }
+
+    ~IntrusivePtr() { reset(); }
+
+    void reset() noexcept {
+        if (object != nullptr && Policy::decrement(object->references)) {
+            delete object;
+        }
+        object = nullptr;
+    }
+
+    T* get() const noexcept { return object; }
+    T& operator*() const noexcept { return *object; }
+    T* operator->() const noexcept { return object; }
+    explicit operator bool() const noexcept { return object != nullptr; }
+    std::uint32_t getUseCount() const { return object ? object->getUseCount() : 0; }
+};
+
+template <typename T, typename Policy, typename... Args>
+IntrusivePtr<T, Policy> makeIntrusive(Args&&... args) {
+    return IntrusivePtr<T, Policy>(new T(std::forward<Args>(args)...), typename IntrusivePtr<T, Policy>::FirstReference{});
+}
 
 // Base Ride class demonstrating encapsulation and inheritance foundation
-class Ride {
+// Heap rides can be shared through IntrusivePtr<Ride> via the embedded count
+class Ride : public RefCounted {
+private:
+    int rideID;
+    LocationId pickupLocation;  // Interned in LocationTable::shared()
+    LocationId dropoffLocation;
+    ZoneId zone;                // Pickup's surge zone
+    TimeBucket timeBucket = 0;
+    double distance;
+    double surgeMultiplier;     // Quoted from the surge table when the ride was created
+
+    // Memoized fare(). Not synchronized: a ride is only priced by the
+    // thread that owns it.
+    mutable double memoFare = 0.0;
+    mutable bool memoValid = false;
+
+protected:
+    double baseFareRate;
+public:
+    // Constructor. The ride keeps the surge multiplier in force now, so a
+    // later surge table only prices rides created after it.
+    Ride(int id, std::string_view pickup, std::string_view dropoff, double dist)
+        : rideID(id), pickupLocation(LocationTable::shared().intern(pickup)),
+          dropoffLocation(LocationTable::shared().intern(dropoff)),
+          zone(LocationTable::shared().zone(pickupLocation)), distance(dist),
+          surgeMultiplier(SurgePricing::shared().multiplier(zone, timeBucket)), baseFareRate(2.0) {
+        RIDE_METRIC_COUNT(RidesCreated, 1);
+    }
+
+    // Constructor from already interned locations
+    Ride(int id, LocationId pickup, LocationId dropoff, double dist)
+        : Ride(id, pickup, dropoff, LocationTable::shared().zone(pickup), dist) {}
+
+    // Constructor with the pickup's zone already looked up, so it does not
+    // touch the LocationTable (used on dispatcher workers)
+    Ride(int id, LocationId pickup, LocationId dropoff, ZoneId pickupZone, double dist)
+        : rideID(id), pickupLocation(pickup), dropoffLocation(dropoff), zone(pickupZone), distance(dist),
+          surgeMultiplier(SurgePricing::shared().multiplier(zone, timeBucket)), baseFareRate(2.0) {
+        RIDE_METRIC_COUNT(RidesCreated, 1);
+    }
+
+    // Virtual destructor for proper polymorphism
+    virtual ~Ride() = default;
+    // Virtual method for polymorphism - to be overridden by subclasses
+    virtual double fare() const {
+        return distance * baseFareRate * getSurgeMultiplier();
+    }
+    // Method to render ride details into a report
+    void renderDetails(ReportWriter& out) const { renderDetails(out, Money::fromDollars(cachedFare())); }
+
+    // Renders the details with the fare given, leaving the fare memo alone,
+    // so any number of threads may render the same ride at once
+    virtual void renderDetails(ReportWriter& out, Money fare) const {
+        out << "Ride ID: " << rideID << '\n';
+        out << "Pickup: " << getPickupLocation() << '\n';
+        out << "Dropoff: " << getDropoffLocation() << '\n';
+        out << "Distance: ";
+        out.fixed(distance) << " miles\n";
+        out << "Fare: $" << fare << '\n';
+    }
+
+    // fare(), recomputed only after a pricing input changes
+    double cachedFare() const {
+        if (!memoValid) {
+            RIDE_METRIC_TIME(FareComputation);
+            RIDE_METRIC_COUNT(FaresComputed, 1);
+            memoFare = fare();
+            memoValid = true;
+        }
+        return memoFare;
+    }
+
+    // Method to display ride details
+    void rideDetails() const {
+        ReportWriter& out = consoleReport();
+        renderDetails(out);
+        out.flushTo(consoleSink());
+    }
+
+    // Getter methods (encapsulation)
+    int getRideID() const { return rideID; }
+    std::string_view getPickupLocation() const { return LocationTable::shared().name(pickupLocation); }
+    std::string_view getDropoffLocation() const { return LocationTable::shared().name(dropoffLocation); }
+    LocationId getPickupLocationId() const { return pickupLocation; }
+    LocationId getDropoffLocationId() const { return dropoffLocation; }
+    GeoPoint getPickupPoint() const { return LocationTable::shared().point(pickupLocation); }
+    GeoPoint getDropoffPoint() const { return LocationTable::shared().point(dropoffLocation); }
+    double getDistance() const { return distance; }
+    double getBaseFareRate() const { return baseFareRate; }
+    ZoneId getZone() const { return zone; }
+    TimeBucket getTimeBucket() const { return timeBucket; }
+    double getSurgeMultiplier() const { return surgeMultiplier; }
+
+    // Time bucket used for surge lookups; requotes the surge multiplier
+    // from the current table. Set before adding to a RideStore.
+    void setTimeBucket(TimeBucket bucket) {
+        timeBucket = bucket;
+        surgeMultiplier = SurgePricing::shared().multiplier(zone, timeBucket);
+        memoValid = false;
+    }
+
+    // Restores the multiplier a ride was charged at (e.g. when recovering
+    // it from a log). Set before adding to a RideStore.
+    void setSurgeMultiplier(double multiplier) {
+        surgeMultiplier = multiplier;
+        memoValid = false;
+    }
+
+    // Fare correction, e.g. after the trip distance is recalculated
+    void setDistance(double dist) {
+        distance = dist;
+        memoValid = false;
+    }
+
+    // Pricing inputs exposed so rides can be mirrored into a RideStore
+    virtual double getLuxuryMultiplier() const { return 1.0; }
+    virtual RideType getTypeTag() const { return RideType::Standard; }
+
+    // Virtual method to get ride type (for polymorphism demonstration)
+    virtual std::string_view getRideType() const { return rideTypeName(RideType::Standard); }
+};
+
+// StandardRide class - inheritance and polymorphism
+// Marked final so calls on a known StandardRide are bound statically
+class StandardRide final : public Ride {
+public:
+    static constexpr RideType typeTag = RideType::Standard;
+
+    StandardRide(int id, std::string_view pickup, std::string_view dropoff, double dist)
+        : Ride(id, pickup, dropoff, dist) {
+        baseFareRate = farePolicyFor(RideType::Standard).baseFareRate;
+    }
+
+    StandardRide(int id, LocationId pickup, LocationId dropoff, double dist)
+        : Ride(id, pickup, dropoff, dist) {
+        baseFareRate = farePolicyFor(RideType::Standard).baseFareRate;
+    }
+
+    StandardRide(int id, LocationId pickup, LocationId dropoff, ZoneId pickupZone, double dist)
+        : Ride(id, pickup, dropoff, pickupZone, dist) {
+        baseFareRate = farePolicyFor(RideType::Standard).baseFareRate;
+    }
+
+    // Override fare method (polymorphism)
+    double fare() const override {
+        return getDistance() * baseFareRate * getSurgeMultiplier();
+    }
+
+    std::string_view getRideType() const override {
+        return rideTypeName(typeTag);
+    }
+};
+
+// PremiumRide class - inheritance and polymorphism
+class PremiumRide final : public Ride {
+private:
+    double luxuryMultiplier;
+
+public:
+    static constexpr RideType typeTag = RideType::Premium;
+
+    PremiumRide(int id, std::string_view pickup, std::string_view dropoff, double dist)
+        : Ride(id, pickup, dropoff, dist), luxuryMultiplier(farePolicyFor(RideType::Premium).luxuryMultiplier) {
+        baseFareRate = farePolicyFor(RideType::Premium).baseFareRate;
+    }
+
+    PremiumRide(int id, LocationId pickup, LocationId dropoff, double dist)
+        : Ride(id, pickup, dropoff, dist), luxuryMultiplier(farePolicyFor(RideType::Premium).luxuryMultiplier) {
+        baseFareRate = farePolicyFor(RideType::Premium).baseFareRate;
+    }
+
+    PremiumRide(int id, LocationId pickup, LocationId dropoff, ZoneId pickupZone, double dist)
+        : Ride(id, pickup, dropoff, pickupZone, dist),
+          luxuryMultiplier(farePolicyFor(RideType::Premium).luxuryMultiplier) {
+        baseFareRate = farePolicyFor(RideType::Premium).baseFareRate;
+    }
+
+    // Override fare method with premium pricing (polymorphism)
+    double fare() const override {
+        return getDistance() * baseFareRate * luxuryMultiplier * getSurgeMultiplier();
+    }
+
+    std::string_view getRideType() const override {
+        return rideTypeName(typeTag);
+    }
+
+    double getLuxuryMultiplier() const override { return luxuryMultiplier; }
+    RideType getTypeTag() const override { return typeTag; }
+
+    using Ride::renderDetails;
+    void renderDetails(ReportWriter& out, Money fare) const override {
+        out << "=== PREMIUM RIDE ===\n";
+        Ride::renderDetails(out, fare);
+        out << "Luxury Multiplier: ";
+        out.fixed(luxuryMultiplier) << "x\n";
+    }
+};
+
+// Closed-set alternative to the virtual hierarchy. std::visit resolves the
+// concrete (final) type, so fare() and the type tag are bound at compile
+// time and hot loops over a vector<RideVariant> can be inlined.
+using RideVariant = std::variant<StandardRide, PremiumRide>;
+
+inline double fare(const RideVariant& ride) {
+    return std::visit([](const auto& r) { return r.fare(); }, ride);
+}
+
+inline RideType rideTypeOf(const RideVariant& ride) {
+    return std::visit([](const auto& r) { return std::decay_t<decltype(r)>::typeTag; }, ride);
+}
+
+inline Money totalFare(const std::vector<RideVariant>& rides) {
+    RIDE_METRIC_COUNT(FaresComputed, rides.size());
+    Money total;
+    for (const auto& ride : rides) {
+        total += Money::fromDollars(fare(ride));
+    }
+    return total;
+}
+
+// Memory resource wrapper that counts the bytes passed through it
+class CountingResource : public std::pmr::memory_resource {
+private:
+    std::pmr::memory_resource* upstream;
+    std::size_t bytesAllocated = 0;
+    std::size_t allocationCount = 0;
+
+    void* do_allocate(std::size_t bytes, std::size_t alignment) override {
+        bytesAllocated += bytes;
+        ++allocationCount;
+        return upstream->allocate(bytes, alignment);
+    }
+    void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) override {
+        upstream->deallocate(p, bytes, alignment);
+    }
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+
+public:
+    explicit CountingResource(std::pmr::memory_resource* up) : upstream(up) {}
+
+    std::size_t getBytesAllocated() const { return bytesAllocated; }
+    std::size_t getAllocationCount() const { return allocationCount; }
+};
+
+// Deleter for rides that may live in a RideArena: runs the destructor and
+// returns the storage to the resource it came from (a no-op for an arena)
+struct RideDeleter {
+    std::pmr::memory_resource* resource = nullptr; // nullptr: allocated with new
+    std::size_t bytes = 0;
+    std::size_t alignment = 0;
+
+    void operator()(Ride* ride) const {
+        if (resource == nullptr) {
+            delete ride;
+            return;
+        }
+        ride->~Ride();
+        resource->deallocate(ride, bytes, alignment);
+    }
+};
+
+// Uniquely owned ride; RideStore is the single owner
+using RidePtr = std::unique_ptr<Ride, RideDeleter>;
+
+// Heap-allocated ride, for rides that do not come from a RideArena
+template <typename T, typename... Args>
+RidePtr makeRide(Args&&... args) {
+    RIDE_METRIC_TIME(RideCreation);
+    return RidePtr(new T(std::forward<Args>(args)...));
+}
+
+// Stable reference to a ride in a RideStore: row plus the generation the
+// row had when the ride was added
+struct RideHandle {
+    std::uint32_t index = 0;
+    std::uint32_t generation = 0;
+
+    bool operator==(const RideHandle&) const = default;
+};
+
+// RideArena - per-shift monotonic arena for Ride objects. Allocation is a
+// pointer bump; nothing is returned to the system until release() frees the
+// whole shift in bulk. Not thread safe.
+class RideArena {
+private:
+    CountingResource systemHeap;   // Blocks the arena reserves from the heap
+    std::pmr::monotonic_buffer_resource pool;
+    CountingResource rideRequests; // Bytes handed out to rides
+
+public:
+    explicit RideArena(std::size_t initialBytes = 64 * 1024)
+        : systemHeap(std::pmr::new_delete_resource()), pool(initialBytes, &systemHeap), rideRequests(&pool) {}
+
+    RideArena(const RideArena&) = delete;
+    RideArena& operator=(const RideArena&) = delete;
+
+    // Constructs a ride in the arena
+    template <typename T, typename... Args>
+    RidePtr make(Args&&... args) {
+        RIDE_METRIC_TIME(RideCreation);
+        void* storage = rideRequests.allocate(sizeof(T), alignof(T));
+        try {
+            return RidePtr(new (storage) T(std::forward<Args>(args)...),
+                           RideDeleter{&rideRequests, sizeof(T), alignof(T)});
+        } catch (...) {
+            rideRequests.deallocate(storage, sizeof(T), alignof(T));
+            throw;
+        }
+    }
+
+    // End of shift: frees every block at once. All rides made from this
+    // arena must already have been destroyed.
+    void release() { pool.release(); }
+
+    std::pmr::memory_resource* resource() { return &rideRequests; }
+    std::size_t getBytesAllocated() const { return rideRequests.getBytesAllocated(); }
+    std::size_t getBytesReserved() const { return systemHeap.getBytesAllocated(); }
+    std::size_t getAllocationCount() const { return rideRequests.getAllocationCount(); }
+};
+
+// RideStore - columnar (structure-of-arrays) ride table and the single
+// owner of every Ride object. Each pricing field lives in its own
+// contiguous array, so fleet-wide fare and earnings queries are linear
+// scans over packed doubles instead of a pointer chase and a virtual call
+// per ride. Standard rides carry a multiplier of 1.0, which keeps the fare
+// formula branch-free.
+// Drivers and riders refer to rides by RideHandle (row + generation), so
+// no reference counting happens when rides are assigned. Removed rows are
+// reused by later rides with a new generation, which makes stale handles
+// detectable; until reused, a removed row has distance 0 and adds nothing
+// to table scans.
+class RideStore {
+public:
+    using Index = std::size_t;
+
+private:
+    std::vector<int> rideIDs;
+    std::vector<double> distances;
+    std::vector<RideType> rideTypes;
+    std::vector<double> fareRates;
+    std::vector<double> multipliers;
+    std::vector<double> surges; // Multiplier each ride was quoted at creation
+    std::vector<std::uint32_t> generations;
+    std::vector<RidePtr> rides; // Cold column, only used to render details
+    std::vector<Index> freeRows;
+
+    Index rowOf(RideHandle handle) const {
+        if (!contains(handle)) {
+            throw std::out_of_range("RideStore: stale or invalid ride handle");
+        }
+        return handle.index;
+    }
+
+public:
+    // Pre-sizes every column, e.g. before a bulk import
+    void reserve(size_t rows) {
+        rideIDs.reserve(rows);
+        distances.reserve(rows);
+        rideTypes.reserve(rows);
+        fareRates.reserve(rows);
+        multipliers.reserve(rows);
+        surges.reserve(rows);
+        generations.reserve(rows);
+        rides.reserve(rows);
+    }
+
+    // Constructs a ride directly in arena storage and takes ownership of it
+    template <typename T, typename... Args>
+    RideHandle emplace(RideArena& arena, Args&&... args) {
+        return add(arena.make<T>(std::forward<Args>(args)...));
+    }
+
+    // Takes ownership of a ride and returns its handle
+    RideHandle add(RidePtr ride) {
+        if (!ride) {
+            throw std::invalid_argument("RideStore::add: null ride");
+        }
+        Index row;
+        if (!freeRows.empty()) {
+            row = freeRows.back();
+            freeRows.pop_back();
+        } else {
+            if (rideIDs.size() >= std::numeric_limits<std::uint32_t>::max()) {
+                throw std::length_error("RideStore: too many rides");
+            }
+            row = rideIDs.size();
+            rideIDs.emplace_back();
+            distances.emplace_back();
+            rideTypes.emplace_back();
+            fareRates.emplace_back();
+            multipliers.emplace_back();
+            surges.emplace_back();
+            generations.emplace_back();
+            rides.emplace_back();
+        }
+        rideIDs[row] = ride->getRideID();
+        distances[row] = ride->getDistance();
+        rideTypes[row] = ride->getTypeTag();
+        fareRates[row] = ride->getBaseFareRate();
+        multipliers[row] = ride->getLuxuryMultiplier();
+        surges[row] = ride->getSurgeMultiplier();
+        rides[row] = std::move(ride);
+        return RideHandle{static_cast<std::uint32_t>(row), generations[row]};
+    }
+
+    // Destroys the ride; outstanding handles to it become stale
+    bool remove(RideHandle handle) {
+        if (!contains(handle)) {
+            return false;
+        }
+        Index row = handle.index;
+        rides[row].reset();
+        distances[row] = 0.0;
+        ++generations[row];
+        freeRows.push_back(row);
+        return true;
+    }
+
+    bool contains(RideHandle handle) const {
+        return handle.index < rides.size() && generations[handle.index] == handle.generation && rides[handle.index];
+    }
+
+    // Counted, but not timed: a few multiplies cost less than the clock read
+    double fareAt(RideHandle handle) const {
+        RIDE_METRIC_COUNT(FaresComputed, 1);
+        Index row = rowOf(handle);
+        return distances[row] * fareRates[row] * multipliers[row] * surges[row];
+    }
+
+    // Fare rounded to the cent, as charged
+    Money chargeAt(RideHandle handle) const { return Money::fromDollars(fareAt(handle)); }
+
+    // Exact sum of the charges of rows [first, last). Charges are rounded
+    // per row and summed as integers, so any split of the table into ranges
+    // adds up to the same total.
+    Money totalFare(Index first, Index last) const {
+        if (first > last || last > distances.size()) {
+            throw std::out_of_range("RideStore::totalFare: row range out of bounds");
+        }
+        RIDE_METRIC_COUNT(FaresComputed, last - first);
+        std::array<std::int64_t, 256> charges;
+        std::int64_t total = 0;
+        while (first < last) {
+            size_t count = std::min(charges.size(), last - first);
+            for (size_t k = 0; k < count; ++k) {
+                Index i = first + k;
+                charges[k] = Money::fromDollars(distances[i] * fareRates[i] * multipliers[i] * surges[i]).getCents();
+            }
+            total += sumCents(std::span<const std::int64_t>(charges.data(), count));
+            first += count;
+        }
+        return Money(total);
+    }
+
+    // Exact sum of every charge in the table
+    Money totalFare() const { return totalFare(0, distances.size()); }
+
+    // Nightly billing: writes the fare of every row into out (indexed by row).
+    // Consecutive rows of the same ride type are priced as one batch by the
+    // SIMD kernel, so tables appended in per-type runs bill at memory speed.
+    void computeFares(std::span<double> out) const {
+        if (out.size() < distances.size()) {
+            throw std::invalid_argument("RideStore::computeFares: output span is smaller than the table");
+        }
+        Index runStart = 0;
+        while (runStart < distances.size()) {
+            Index runEnd = runStart + 1;
+            while (runEnd < distances.size() && rideTypes[runEnd] == rideTypes[runStart]) {
+                ++runEnd;
+            }
+            std::span<const double> run(distances.data() + runStart, runEnd - runStart);
+            ::computeFares(run, rideTypes[runStart], out.subspan(runStart, run.size()));
+            runStart = runEnd;
+        }
+        // Each ride's quoted surge is applied as a second, vectorizable pass
+        for (Index i = 0; i < distances.size(); ++i) {
+            out[i] *= surges[i];
+        }
+    }
+
+    // Sum of the charges of a subset of rides (e.g. one driver's rides)
+    Money totalFare(const std::vector<RideHandle>& handles) const {
+        Money total;
+        for (RideHandle handle : handles) {
+            total += chargeAt(handle);
+        }
+        return total;
+    }
+
+    // Corrects a ride's distance in both the column and the Ride object.
+    // Drivers and riders holding the ride must then call repriceRide().
+    void updateDistance(RideHandle handle, double dist) {
+        Index row = rowOf(handle);
+        distances[row] = dist;
+        rides[row]->setDistance(dist);
+    }
+
+    // Getter methods
+    int getRideID(RideHandle handle) const { return rideIDs[rowOf(handle)]; }
+    double getDistance(RideHandle handle) const { return distances[rowOf(handle)]; }
+    RideType getTypeTag(RideHandle handle) const { return rideTypes[rowOf(handle)]; }
+    const Ride& getRide(RideHandle handle) const { return *rides[rowOf(handle)]; }
+
+    // Row-level access for iterating the table; rows may be empty after remove()
+    size_t size() const { return rideIDs.size(); }
+    bool isLive(Index row) const { return static_cast<bool>(rides[row]); }
+    RideHandle handleAt(Index row) const { return RideHandle{static_cast<std::uint32_t>(row), generations[row]}; }
+};
+
+// Running fare totals, kept up to date as rides are added, repriced or removed
+struct RideTotals {
+    Money amount;
+    size_t rides = 0;
+    std::array<Money, rideTypeCount> amountByType{};
+    std::array<size_t, rideTypeCount> ridesByType{};
+
+    void add(RideType type, Money fare) {
+        amount += fare;
+        ++rides;
+        amountByType[static_cast<size_t>(type)] += fare;
+        ++ridesByType[static_cast<size_t>(type)];
+    }
+
+    void remove(RideType type, Money fare) {
+        amount -= fare;
+        --rides;
+        amountByType[static_cast<size_t>(type)] -= fare;
+        --ridesByType[static_cast<size_t>(type)];
+    }
+};
+
+// A ride moved out of a history's hot window. Self-contained, so it can
+// still be rendered after the ride itself is removed from the store.
+struct SpilledRide {
+    RideHandle ride;           // Handle at spill time; stale once the ride is removed
+    std::int32_t rideID;
+    RideType type;
+    bool removed;              // Tombstone: removed from the history after spilling
+    std::uint8_t reserved[2];
+    LocationId pickup;         // Interned in LocationTable::shared()
+    LocationId dropoff;
+    double distance;
+    double luxuryMultiplier;
+    std::int64_t chargedCents; // Fare counted in the history's totals
+
+    // Same layout as Ride::renderDetails(), with the fare as charged
+    void renderDetails(ReportWriter& out) const {
+        if (type == RideType::Premium) {
+            out << "=== PREMIUM RIDE ===\n";
+        }
+        out << "Ride ID: " << rideID << '\n';
+        out << "Pickup: " << LocationTable::shared().name(pickup) << '\n';
+        out << "Dropoff: " << LocationTable::shared().name(dropoff) << '\n';
+        out << "Distance: ";
+        out.fixed(distance) << " miles\n";
+        out << "Fare: $" << Money(chargedCents) << '\n';
+        if (type == RideType::Premium) {
+            out << "Luxury Multiplier: ";
+            out.fixed(luxuryMultiplier) << "x\n";
+        }
+    }
+};
+
+static_assert(sizeof(SpilledRide) == 48 && std::is_trivially_copyable_v<SpilledRide>);
+
+// RideSpillFile - append-only cold tier shared by ride histories.
+// Histories spill whole blocks of SpilledRide records and remember only
+// each block's offset, then page the blocks back with pread() when the full
+// history is read, and overwrite single records in place to correct them.
+// Appends reserve their range atomically, so histories on different threads
+// can share one file. It is scratch storage for this
+// process (records name rides by handle and interned location), unlike the
+// ride ledger, and is removed when the object is destroyed.
+class RideSpillFile {
+private:
+    std::string path;
+    int fd;
+    std::atomic<std::uint64_t> size{0};
+
+public:
+    explicit RideSpillFile(std::string filePath)
+        : path(std::move(filePath)), fd(::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600)) {
+        if (fd < 0) {
+            throw std::system_error(errno, std::generic_category(), "RideSpillFile: cannot open " + path);
+        }
+    }
+
+    ~RideSpillFile() {
+        ::close(fd);
+        ::unlink(path.c_str());
+    }
+
+    RideSpillFile(const RideSpillFile&) = delete;
+    RideSpillFile& operator=(const RideSpillFile&) = delete;
+
+    // Writes the records as one block and returns its offset
+    std::uint64_t append(std::span<const SpilledRide> records) {
+        std::uint64_t offset = size.fetch_add(records.size_bytes(), std::memory_order_relaxed);
+        write(offset, records);
+        return offset;
+    }
+
+    // Overwrites records previously appended at offset
+    void write(std::uint64_t offset, std::span<const SpilledRide> records) {
+        size_t length = records.size_bytes();
+        const char* data = reinterpret_cast<const char*>(records.data());
+        for (size_t done = 0; done < length;) {
+            ssize_t written = ::pwrite(fd, data + done, length - done, static_cast<off_t>(offset + done));
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw std::system_error(errno, std::generic_category(), "RideSpillFile: write failed");
+            }
+            done += static_cast<size_t>(written);
+        }
+    }
+
+    // Reads back a block written by append()
+    void read(std::uint64_t offset, std::span<SpilledRide> records) const {
+        size_t length = records.size_bytes();
+        char* data = reinterpret_cast<char*>(records.data());
+        for (size_t done = 0; done < length;) {
+            ssize_t got = ::pread(fd, data + done, length - done, static_cast<off_t>(offset + done));
+            if (got < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw std::system_error(errno, std::generic_category(), "RideSpillFile: read failed");
+            }
+            if (got == 0) {
+                throw std::runtime_error("RideSpillFile: block past end of file");
+            }
+            done += static_cast<size_t>(got);
+        }
+    }
+
+    std::uint64_t getSize() const { return size.load(std::memory_order_relaxed); }
+    const std::string& getPath() const { return path; }
+};
+
+// RideHistory - the rides belonging to one driver or rider.
+// The fare and type counted for each ride are remembered, so a later fare
+// adjustment or removal updates the totals by exactly what was added before
+// (even if the ride is already gone from the store), and the totals are
+// available in O(1).
+// Recent rides live in a ring buffer. Without a spill file it grows as
+// needed; with one it holds at most hotCapacity rides, and when full the
+// older half is written to the spill file as one block. Spilled rides stay
+// in the totals and can still be repriced or removed: the hot window is
+// searched first, then the spilled blocks are paged in (O(spilled rides) of
+// reads, fine for corrections) and the one record is rewritten in place,
+// removal leaving a tombstone. forEachRide() pages them back in order.
+class RideHistory {
+private:
+    struct Entry {
+        RideHandle ride;
+        Money fare;
+        RideType type;
+    };
+
+    struct SpillBlock {
+        std::uint64_t offset;
+        std::uint32_t count;
+    };
+
+    const RideStore* rideStore;
+    std::vector<Entry> ring;      // ring.size() is the current capacity
+    size_t head = 0;              // Oldest hot entry
+    size_t hotCount = 0;
+    RideSpillFile* spill = nullptr;
+    size_t hotCapacity = 0;
+    std::vector<SpillBlock> spilledBlocks;
+    size_t spilledCount = 0;
+    RideTotals totals;
+    std::uint64_t revision = 0;   // Bumped on every change, for render caches
+
+    // i-th hot entry, oldest first
+    size_t slot(size_t i) const { return head + i >= ring.size() ? head + i - ring.size() : head + i; }
+    Entry& at(size_t i) { return ring[slot(i)]; }
+    const Entry& at(size_t i) const { return ring[slot(i)]; }
+
+    size_t position(RideHandle ride) const {
+        for (size_t i = 0; i < hotCount; ++i) {
+            if (at(i).ride == ride) {
+                return i;
+            }
+        }
+        return hotCount;
+    }
+
+    // Re-lays the hot entries out from slot 0 in a ring of the given capacity
+    void resize(size_t capacity) {
+        std::vector<Entry> grown(capacity);
+        for (size_t i = 0; i < hotCount; ++i) {
+            grown[i] = at(i);
+        }
+        ring = std::move(grown);
+        head = 0;
+    }
+
+    // Copies the ride's current details into its spilled record
+    void describe(SpilledRide& record) const {
+        if (rideStore->contains(record.ride)) {
+            const Ride& ride = rideStore->getRide(record.ride);
+            record.rideID = ride.getRideID();
+            record.pickup = ride.getPickupLocationId();
+            record.dropoff = ride.getDropoffLocationId();
+            record.distance = ride.getDistance();
+            record.luxuryMultiplier = ride.getLuxuryMultiplier();
+        }
+    }
+
+    // Moves the oldest count hot entries to the spill file as one block
+    void spillOldest(size_t count) {
+        std::vector<SpilledRide> block(count);
+        for (size_t i = 0; i < count; ++i) {
+            const Entry& entry = at(i);
+            SpilledRide& record = block[i];
+            record.ride = entry.ride;
+            record.type = entry.type;
+            record.chargedCents = entry.fare.getCents();
+            describe(record);
+        }
+        spilledBlocks.push_back({spill->append(block), static_cast<std::uint32_t>(count)});
+        spilledCount += count;
+        head = slot(count);
+        hotCount -= count;
+    }
+
+    // Finds the live spilled record of ride, lets update change it and
+    // writes it back in place
+    template <typename Update>
+    bool updateSpilled(RideHandle ride, Update&& update) {
+        std::vector<SpilledRide> block;
+        for (const SpillBlock& spilled : spilledBlocks) {
+            block.resize(spilled.count);
+            spill->read(spilled.offset, block);
+            for (size_t i = 0; i < block.size(); ++i) {
+                SpilledRide& record = block[i];
+                if (record.ride == ride && !record.removed) {
+                    update(record);
+                    spill->write(spilled.offset + i * sizeof(SpilledRide), std::span<const SpilledRide>(&record, 1));
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+public:
+    explicit RideHistory(const RideStore& rides) : rideStore(&rides) {}
+
+    // Bounds the hot window to capacity rides, spilling older ones to file.
+    // The spill file must outlive the history. May be called again to change
+    // the capacity, but once rides have spilled the file must stay the same:
+    // the spilled blocks are offsets into it.
+    void setSpill(RideSpillFile& file, size_t capacity) {
+        if (capacity == 0 || capacity > std::numeric_limits<std::uint32_t>::max()) {
+            throw std::invalid_argument("RideHistory::setSpill: hot capacity must be between 1 and 2^32-1");
+        }
+        if (!spilledBlocks.empty() && &file != spill) {
+            throw std::logic_error("RideHistory::setSpill: rides already spilled to another file");
+        }
+        spill = &file;
+        hotCapacity = capacity;
+        if (hotCount > capacity) {
+            spillOldest(hotCount - capacity);
+        }
+        resize(capacity);
+    }
+
+    void add(RideHandle ride) {
+        Entry entry{ride, rideStore->chargeAt(ride), rideStore->getTypeTag(ride)};
+        if (hotCount == ring.size()) {
+            if (spill != nullptr) {
+                spillOldest(std::max<size_t>(1, hotCapacity / 2));
+            } else {
+                resize(std::max<size_t>(4, ring.size() * 2));
+            }
+        }
+        at(hotCount++) = entry;
+        totals.add(entry.type, entry.fare);
+        ++revision;
+    }
+
+    // Re-reads the fare of a ride whose pricing inputs changed in the store.
+    // False if the ride is not in this history.
+    bool reprice(RideHandle ride) {
+        size_t pos = position(ride);
+        if (pos == hotCount) {
+            bool found = spilledCount != 0 && updateSpilled(ride, [&](SpilledRide& record) {
+                Money fare = rideStore->chargeAt(ride);
+                totals.remove(record.type, Money(record.chargedCents));
+                totals.add(record.type, fare);
+                record.chargedCents = fare.getCents();
+                describe(record);
+            });
+            revision += found;
+            return found;
+        }
+        Entry& entry = at(pos);
+        Money fare = rideStore->chargeAt(ride);
+        totals.remove(entry.type, entry.fare);
+        totals.add(entry.type, fare);
+        entry.fare = fare;
+        ++revision;
+        return true;
+    }
+
+    // False if the ride is not in this history
+    bool remove(RideHandle ride) {
+        size_t pos = position(ride);
+        if (pos == hotCount) {
+            bool found = spilledCount != 0 && updateSpilled(ride, [&](SpilledRide& record) {
+                totals.remove(record.type, Money(record.chargedCents));
+                record.removed = true;
+            });
+            spilledCount -= found;
+            revision += found;
+            return found;
+        }
+        totals.remove(at(pos).type, at(pos).fare);
+        for (size_t i = pos; i + 1 < hotCount; ++i) {
+            at(i) = at(i + 1);
+        }
+        --hotCount;
+        ++revision;
+        return true;
+    }
+
+    // Visits every ride, oldest first, as visit(handle, charged, spilled).
+    // charged is the fare counted in the totals; spilled is the paged-back
+    // record for rides out of the hot window, else null.
+    template <typename Visitor>
+    void forEachRide(Visitor&& visit) const {
+        std::vector<SpilledRide> block;
+        for (const SpillBlock& spilled : spilledBlocks) {
+            block.resize(spilled.count);
+            spill->read(spilled.offset, block);
+            for (const SpilledRide& record : block) {
+                if (!record.removed) {
+                    visit(record.ride, Money(record.chargedCents), &record);
+                }
+            }
+        }
+        for (size_t i = 0; i < hotCount; ++i) {
+            visit(at(i).ride, at(i).fare, static_cast<const SpilledRide*>(nullptr));
+        }
+    }
+
+    const RideStore& store() const { return *rideStore; }
+    size_t getHotCount() const { return hotCount; }
+    size_t getSpilledCount() const { return spilledCount; }
+    const RideTotals& getTotals() const { return totals; }
+    std::uint64_t getRevision() const { return revision; }
+};
+
+// DriverSnapshot / RiderSnapshot - immutable point-in-time views of a
+// driver's or rider's state. Changes only mark the view stale; the owner
+// republishes it with publishSnapshot() once per batch of changes (a drained
+// dispatcher queue, a matching round, an import), so ingestion does not pay
+// for a snapshot per ride.
+// Analytics and reporting threads read them under an EpochGuard while the
+// owner keeps ingesting rides; a snapshot's fields always belong to the
+// same moment (ride count matches earnings, per type as well). The rides
+// themselves are not copied: the snapshot holds the totals, not the store.
+// The name never changes, so it is viewed rather than copied; like the
+// snapshot, it lives as long as its driver or rider.
+struct DriverSnapshot {
+    int driverID = 0;
+    std::string_view name;
+    double rating = 0.0;
+    RideTotals earnings;
+    size_t spilledRides = 0;
+    std::uint64_t revision = 0; // RideHistory revision the view was taken at
+};
+
+struct RiderSnapshot {
+    int riderID = 0;
+    std::string_view name;
+    RideTotals spending;
+    size_t spilledRides = 0;
+    std::uint64_t revision = 0;
+};
+
+class Driver;
+class Rider;
+
+// RideEventListener - observer notified after rides are assigned or
+// requested, and after a driver's earnings change because one of its rides
+// was repriced or removed
+class RideEventListener {
+public:
+    virtual ~RideEventListener() = default;
+    virtual void onRideAssigned(const Driver& driver, const Ride& ride) = 0;
+    virtual void onRideRequested(const Rider& rider, const Ride& ride) = 0;
+    virtual void onEarningsChanged(const Driver&) {}
+};
+
+// Driver class demonstrating encapsulation
+class Driver {
+private:
+    int driverID;
+    std::string name;
+    double rating;
+    RideHistory assignedRides; // Encapsulated - private member
+    std::vector<RideEventListener*> listeners;
+    Versioned<DriverSnapshot> snapshots;
+    bool snapshotStale = false; // Rides changed since the last publishSnapshot()
+
+    DriverSnapshot makeSnapshot() const {
+        return {driverID, name, rating, assignedRides.getTotals(), assignedRides.getSpilledCount(),
+                assignedRides.getRevision()};
+    }
+
+    void earningsChanged() {
+        snapshotStale = true;
+        for (RideEventListener* listener : listeners) {
+            listener->onEarningsChanged(*this);
+        }
+    }
+
+    static void renderView(ReportWriter& out, const DriverSnapshot& view) {
+        out << "\n=== DRIVER INFORMATION ===\n";
+        out << "Driver ID: " << view.driverID << '\n';
+        out << "Name: " << view.name << '\n';
+        out << "Rating: " << view.rating << "/5.0\n";
+        out << "Total Rides Completed: " << view.earnings.rides << '\n';
+        out << "Total Earnings: $" << view.earnings.amount << '\n';
+    }
+
+public:
+    // Name is taken by value and moved in, so temporaries are not copied
+    Driver(int id, std::string driverName, double driverRating, const RideStore& rides)
+        : driverID(id), name(std::move(driverName)), rating(driverRating), assignedRides(rides),
+          snapshots(makeSnapshot()) {}
+
+    // Method to add ride (controlled access to private member)
+    void addRide(RideHandle ride) {
+        RIDE_METRIC_TIME(RideAssignment);
+        RIDE_METRIC_COUNT(RidesAssigned, 1);
+        assignedRides.add(ride);
+        snapshotStale = true;
+        for (RideEventListener* listener : listeners) {
+            listener->onRideAssigned(*this, assignedRides.store().getRide(ride));
+        }
+    }
+
+    // Adds a ride without notifying listeners (used when recovering state)
+    void restoreRide(RideHandle ride) {
+        assignedRides.add(ride);
+        snapshotStale = true;
+    }
+
+    // Publishes the changes made since the last call, if any; owner thread only
+    void publishSnapshot() {
+        if (snapshotStale) {
+            snapshots.publish(makeSnapshot());
+            snapshotStale = false;
+        }
+    }
+    bool isSnapshotStale() const { return snapshotStale; }
+
+    // Constructs a ride in place in rides (the store this driver reads)
+    // and assigns it, e.g. emplaceRide<PremiumRide>(fleet, shift, 5, "Hotel", "Airport", 9.0)
+    template <typename T, typename... Args>
+    RideHandle emplaceRide(RideStore& rides, RideArena& arena, Args&&... args) {
+        if (&rides != &assignedRides.store()) {
+            throw std::invalid_argument("Driver::emplaceRide: store does not belong to this driver");
+        }
+        RideHandle ride = rides.emplace<T>(arena, std::forward<Args>(args)...);
+        addRide(ride);
+        return ride;
+    }
+
+    // Listener must outlive the driver or be removed first
+    void addListener(RideEventListener& listener) { listeners.push_back(&listener); }
+    void removeListener(RideEventListener& listener) {
+        listeners.erase(std::remove(listeners.begin(), listeners.end(), &listener), listeners.end());
+    }
+
+    // Keeps only the latest hotCapacity rides in memory; see RideHistory
+    void spillHistoryTo(RideSpillFile& spill, size_t hotCapacity) {
+        assignedRides.setSpill(spill, hotCapacity);
+        snapshotStale = true;
+    }
+
+    // Call after the ride's fare changed in the RideStore
+    bool repriceRide(RideHandle ride) {
+        if (!assignedRides.reprice(ride)) {
+            return false;
+        }
+        earningsChanged();
+        return true;
+    }
+    bool removeRide(RideHandle ride) {
+        if (!assignedRides.remove(ride)) {
+            return false;
+        }
+        earningsChanged();
+        return true;
+    }
+
+    // Latest published view; safe to read from any thread while the owner
+    // adds rides, and valid while guard is alive. Lags changes the owner has
+    // not published yet.
+    const DriverSnapshot& snapshot(const EpochGuard& guard) const { return snapshots.read(guard); }
+
+    // Method to render driver info into a report, from the published
+    // snapshot, so it may run on a reporting thread while rides are being
+    // assigned (statement batches use it). Shows what was last published.
+    void renderInfo(ReportWriter& out) const {
+        EpochGuard guard;
+        renderView(out, snapshot(guard));
+    }
+
+    // Method to display driver info, for the owner thread: renders the live
+    // history, so rides added since the last publish are included
+    void getDriverInfo() const {
+        ReportWriter& out = consoleReport();
+        renderView(out, makeSnapshot());
+        out.flushTo(consoleSink());
+    }
+
+    // Getter methods (controlled access)
+    int getDriverID() const { return driverID; }
+    const std::string& getName() const { return name; }
+    double getRating() const { return rating; }
+    size_t getRideCount() const { return assignedRides.getTotals().rides; }
+    size_t getSpilledRideCount() const { return assignedRides.getSpilledCount(); }
+    Money getTotalEarnings() const { return assignedRides.getTotals().amount; }
+    const RideTotals& getEarnings() const { return assignedRides.getTotals(); }
+};
+
+// Rider class demonstrating encapsulation
+class Rider {
+private:
+    int riderID;
+    std::string name;
+    RideHistory requestedRides; // Encapsulated - private member
+    std::vector<RideEventListener*> listeners;
+    Versioned<RiderSnapshot> snapshots;
+    bool snapshotStale = false; // Rides changed since the last publishSnapshot()
+
+    // Last rendered history, reused until the history changes
+    mutable std::string renderedRides;
+    mutable std::uint64_t renderedRevision = 0;
+    mutable bool renderedValid = false;
+
+    RiderSnapshot makeSnapshot() const {
+        return {riderID, name, requestedRides.getTotals(), requestedRides.getSpilledCount(),
+                requestedRides.getRevision()};
+    }
+
+public:
+    Rider(int id, std::string riderName, const RideStore& rides)
+        : riderID(id), name(std::move(riderName)), requestedRides(rides), snapshots(makeSnapshot()) {}
+
+    // Method to request a ride (controlled access to private member)
+    void requestRide(RideHandle ride) {
+        addRide(ride);
+        std::cout << "Ride requested by " << name << " (ID: " << riderID << ")" << std::endl;
+    }
+
+    // Records a requested ride and notifies listeners, without printing
+    // (for request paths that report on their own)
+    void addRide(RideHandle ride) {
+        RIDE_METRIC_TIME(RideRequest);
+        RIDE_METRIC_COUNT(RidesRequested, 1);
+        requestedRides.add(ride);
+        snapshotStale = true;
+        for (RideEventListener* listener : listeners) {
+            listener->onRideRequested(*this, requestedRides.store().getRide(ride));
+        }
+    }
+
+    // Adds a ride without notifying listeners or printing (used when
+    // recovering state)
+    void restoreRide(RideHandle ride) {
+        requestedRides.add(ride);
+        snapshotStale = true;
+    }
+
+    // Publishes the changes made since the last call, if any; owner thread only
+    void publishSnapshot() {
+        if (snapshotStale) {
+            snapshots.publish(makeSnapshot());
+            snapshotStale = false;
+        }
+    }
+    bool isSnapshotStale() const { return snapshotStale; }
+
+    // Constructs a ride in place in rides (the store this rider reads) and requests it
+    template <typename T, typename... Args>
+    RideHandle emplaceRide(RideStore& rides, RideArena& arena, Args&&... args) {
+        if (&rides != &requestedRides.store()) {
+            throw std::invalid_argument("Rider::emplaceRide: store does not belong to this rider");
+        }
+        RideHandle ride = rides.emplace<T>(arena, std::forward<Args>(args)...);
+        requestRide(ride);
+        return ride;
+    }
+
+    // Listener must outlive the rider or be removed first
+    void addListener(RideEventListener& listener) { listeners.push_back(&listener); }
+    void removeListener(RideEventListener& listener) {
+        listeners.erase(std::remove(listeners.begin(), listeners.end(), &listener), listeners.end());
+    }
+
+    // Keeps only the latest hotCapacity rides in memory; see RideHistory
+    void spillHistoryTo(RideSpillFile& spill, size_t hotCapacity) {
+        requestedRides.setSpill(spill, hotCapacity);
+        snapshotStale = true;
+    }
+
+    // Call after the ride's fare changed in the RideStore
+    bool repriceRide(RideHandle ride) {
+        if (!requestedRides.reprice(ride)) {
+            return false;
+        }
+        snapshotStale = true;
+        return true;
+    }
+    bool removeRide(RideHandle ride) {
+        if (!requestedRides.remove(ride)) {
+            return false;
+        }
+        snapshotStale = true;
+        return true;
+    }
+
+    // Latest published view; safe to read from any thread while the owner
+    // requests rides, and valid while guard is alive. Lags changes the owner
+    // has not published yet.
+    const RiderSnapshot& snapshot(const EpochGuard& guard) const { return snapshots.read(guard); }
+
+    // Method to render ride history into a report. The text is built on the
+    // first view and replayed afterwards; a ride whose distance is corrected
+    // in the store must be repriced via repriceRide() to refresh it. Spilled
+    // rides are paged back from the spill file on every view instead, so the
+    // full history is never held in memory. This fills the render cache, so
+    // it belongs on the owner's thread; see renderStatement().
+    void renderRides(ReportWriter& out) const {
+        if (renderedValid && renderedRevision == requestedRides.getRevision()) {
+            out << renderedRides;
+            return;
+        }
+        size_t start = out.view().size();
+        renderStatement(out);
+        if (requestedRides.getSpilledCount() != 0) {
+            return;
+        }
+        renderedRides.assign(out.view().substr(start));
+        renderedRevision = requestedRides.getRevision();
+        renderedValid = true;
+    }
+
+    // Same text as renderRides(), rendered afresh without writing the render
+    // cache or any ride's fare memo, so statement batches may run it on
+    // several threads at once. Each ride shows the fare as charged, the
+    // amount counted in the total, so the lines always add up to it. The
+    // history must not change meanwhile: the owner runs batches between
+    // rounds of rides, not during them.
+    void renderStatement(ReportWriter& out) const {
+        out << "\n=== RIDER RIDE HISTORY ===\n";
+        out << "Rider: " << name << " (ID: " << riderID << ")\n";
+        out << "Total Rides: " << getRideCount() << '\n';
+        
+        const RideStore& rides = requestedRides.store();
+        size_t number = 0;
+        requestedRides.forEachRide([&](RideHandle ride, Money charged, const SpilledRide* spilled) {
+            out << "\n--- Ride " << ++number << " ---\n";
+            if (spilled != nullptr && !rides.contains(ride)) {
+                spilled->renderDetails(out);
+            } else {
+                rides.getRide(ride).renderDetails(out, charged);
+            }
+        });
+        out << "\nTotal Amount Spent: $" << getTotalSpent() << '\n';
+    }
+
+    // Method to view ride history
+    void viewRides() const {
+        ReportWriter& out = consoleReport();
+        renderRides(out);
+        out.flushTo(consoleSink());
+    }
+
+    // Getter methods (controlled access)
+    int getRiderID() const { return riderID; }
+    const std::string& getName() const { return name; }
+    size_t getRideCount() const { return requestedRides.getTotals().rides; }
+    size_t getSpilledRideCount() const { return requestedRides.getSpilledCount(); }
+    Money getTotalSpent() const { return requestedRides.getTotals().amount; }
+    const RideTotals& getSpending() const { return requestedRides.getTotals(); }
+};
+
+// DriverLeaderboard - live top-K drivers by earnings and by rating.
+// Two ordered indexes (best first, ties broken by driver ID) are updated
+// in O(log N) whenever a tracked driver's earnings change (a ride is
+// assigned, repriced or removed), so a top-K query walks K nodes instead of
+// sorting every driver. Rides restored with restoreRide() do not notify
+// listeners; call update() after them.
+class DriverLeaderboard : public RideEventListener {
+public:
+    struct Entry {
+        int driverID;
+        Money earnings;
+        double rating;
+    };
+
+private:
+    struct ByEarnings {
+        bool operator()(const Entry& a, const Entry& b) const {
+            if (a.earnings != b.earnings) {
+                return a.earnings > b.earnings;
+            }
+            return a.driverID < b.driverID;
+        }
+    };
+    struct ByRating {
+        bool operator()(const Entry& a, const Entry& b) const {
+            if (a.rating != b.rating) {
+                return a.rating > b.rating;
+            }
+            return a.driverID < b.driverID;
+        }
+    };
+
+    mutable std::shared_mutex mutex;
+    std::unordered_map<int, Entry> entries; // Current key of each tracked driver
+    std::set<Entry, ByEarnings> byEarnings;
+    std::set<Entry, ByRating> byRating;
+
+    template <typename Index>
+    static std::vector<Entry> top(const Index& index, size_t k) {
+        std::vector<Entry> result;
+        result.reserve(std::min(k, index.size()));
+        for (auto it = index.begin(); it != index.end() && result.size() < k; ++it) {
+            result.push_back(*it);
+        }
+        return result;
+    }
+
+public:
+    // Starts tracking a driver, or refreshes its entry if already tracked
+    void update(const Driver& driver) {
+        Entry next{driver.getDriverID(), driver.getTotalEarnings(), driver.getRating()};
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        auto [it, inserted] = entries.try_emplace(next.driverID, next);
+        if (!inserted) {
+            byEarnings.erase(it->second);
+            byRating.erase(it->second);
+            it->second = next;
+        }
+        byEarnings.insert(next);
+        byRating.insert(next);
+    }
+
+    bool remove(int driverID) {
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        auto it = entries.find(driverID);
+        if (it == entries.end()) {
+            return false;
+        }
+        byEarnings.erase(it->second);
+        byRating.erase(it->second);
+        entries.erase(it);
+        return true;
+    }
+
+    std::vector<Entry> topByEarnings(size_t k) const {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        return top(byEarnings, k);
+    }
+
+    std::vector<Entry> topByRating(size_t k) const {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        return top(byRating, k);
+    }
+
+    size_t size() const {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        return entries.size();
+    }
+
+    void onRideAssigned(const Driver& driver, const Ride&) override { update(driver); }
+    void onRideRequested(const Rider&, const Ride&) override {}
+    void onEarningsChanged(const Driver& driver) override { update(driver); }
+};
+
+// WorkStealingPool - fixed set of workers for parallel loops over task
+// indices. Each run deals the indices round-robin into per-worker deques;
+// a worker takes its own tasks from the front (lowest index first) and,
+// once empty, steals from the back of another worker's deque. Tasks are
+// meant to be coarse (a chunk of work each), so a mutex per deque is cheap.
+class WorkStealingPool {
+private:
+    struct TaskQueue {
+        std::mutex mutex;
+        std::deque<size_t> tasks;
+    };
+
+    std::vector<std::unique_ptr<TaskQueue>> queues; // queues[0] belongs to the calling thread
+    std::vector<std::thread> threads;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable finished;
+    const std::function<void(size_t)>* job = nullptr;
+    std::uint64_t generation = 0;
+    size_t active = 0;
+    bool stopping = false;
+    std::atomic<size_t> pending{0};
+    std::exception_ptr failure;
+
+    bool takeTask(size_t self, size_t& task) {
+        {
+            TaskQueue& own = *queues[self];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (!own.tasks.empty()) {
+                task = own.tasks.front();
+                own.tasks.pop_front();
+                return true;
+            }
+        }
+        for (size_t offset = 1; offset < queues.size(); ++offset) {
+            TaskQueue& victim = *queues[(self + offset) % queues.size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.tasks.empty()) {
+                task = victim.tasks.back();
+                victim.tasks.pop_back();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void drain(size_t self, const std::function<void(size_t)>& task) {
+        size_t index;
+        while (takeTask(self, index)) {
+            try {
+                task(index);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!failure) {
+                    failure = std::current_exception();
+                }
+            }
+            pending.fetch_sub(1, std::memory_order_acq_rel);
+        }
+    }
+
+    void workerLoop(size_t self) {
+        std::uint64_t seen = 0;
+        for (;;) {
+            const std::function<void(size_t)>* current;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [&] { return stopping || generation != seen; });
+                if (stopping) {
+                    return;
+                }
+                seen = generation;
+                current = job;
+                if (current == nullptr) {
+                    continue; // Woke after that run already completed
+                }
+                ++active;
+            }
+            drain(self, *current);
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--active == 0) {
+                finished.notify_all();
+            }
+        }
+    }
+
+public:
+    // The calling thread of parallelFor() also works, so threadCount - 1
+    // extra threads are started
+    explicit WorkStealingPool(size_t threadCount = std::max(1u, std::thread::hardware_concurrency())) {
+        threadCount = std::max<size_t>(threadCount, 1);
+        for (size_t i = 0; i < threadCount; ++i) {
+            queues.push_back(std::make_unique<TaskQueue>());
+        }
+        for (size_t i = 1; i < threadCount; ++i) {
+            threads.emplace_back(&WorkStealingPool::workerLoop, this, i);
+        }
+    }
+
+    ~WorkStealingPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    // Runs task(0) .. task(taskCount - 1) and returns when all are done.
+    // The first exception thrown by a task is rethrown here.
+    void parallelFor(size_t taskCount, const std::function<void(size_t)>& task) {
+        if (taskCount == 0) {
+            return;
+        }
+        for (size_t i = 0; i < queues.size(); ++i) {
+            std::lock_guard<std::mutex> lock(queues[i]->mutex);
+            for (size_t index = i; index < taskCount; index += queues.size()) {
+                queues[i]->tasks.push_back(index);
+            }
+        }
+        pending.store(taskCount, std::memory_order_release);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            job = &task;
+            failure = nullptr;
+            ++generation;
+        }
+        wake.notify_all();
+        drain(0, task);
+
+        std::unique_lock<std::mutex> lock(mutex);
+        finished.wait(lock, [&] { return active == 0 && pending.load(std::memory_order_acquire) == 0; });
+        job = nullptr;
+        if (failure) {
+            std::rethrow_exception(std::exchange(failure, nullptr));
+        }
+    }
+
+    size_t size() const { return queues.size(); }
+};
+
+// Renders count items in parallel, chunkSize items per task and one
+// buffer per chunk, and writes the chunks to sink strictly in index order.
+// Whichever thread completes the next chunk in order writes it (and any
+// completed successors), so output streams while later chunks render.
+template <typename RenderItem>
+void renderInOrder(WorkStealingPool& pool, size_t count, ReportSink& sink, RenderItem renderItem,
+                   size_t chunkSize = 256) {
+    size_t chunks = (count + chunkSize - 1) / chunkSize;
+    std::vector<ReportWriter> buffers(chunks);
+    std::vector<char> complete(chunks, 0);
+    size_t nextToWrite = 0;
+    std::mutex outputMutex;
+
+    pool.parallelFor(chunks, [&](size_t chunk) {
+        ReportWriter out;
+        for (size_t i = chunk * chunkSize; i < std::min(count, (chunk + 1) * chunkSize); ++i) {
+            renderItem(i, out);
+        }
+        std::lock_guard<std::mutex> lock(outputMutex);
+        buffers[chunk] = std::move(out);
+        complete[chunk] = 1;
+        while (nextToWrite < chunks && complete[nextToWrite]) {
+            buffers[nextToWrite].flushTo(sink);
+            buffers[nextToWrite] = ReportWriter(); // Release the buffer
+            ++nextToWrite;
+        }
+    });
+}
+
+// Month-end statements for many drivers, in the order given
+inline void writeDriverStatements(WorkStealingPool& pool, std::span<const Driver* const> drivers, ReportSink& sink) {
+    renderInOrder(pool, drivers.size(), sink, [&](size_t i, ReportWriter& out) { drivers[i]->renderInfo(out); });
+}
+
+// Month-end statements for many riders, in the order given. Rendering is
+// read-only (see Rider::renderStatement()), so riders may share rides or
+// repeat; none may take rides until the call returns.
+inline void writeRiderStatements(WorkStealingPool& pool, std::span<const Rider* const> riders, ReportSink& sink) {
+    renderInOrder(pool, riders.size(), sink, [&](size_t i, ReportWriter& out) { riders[i]->renderStatement(out); });
+}
+
+// Parallel billing: exact total of every charge in the table. Partial sums
+// are integers, so the result equals RideStore::totalFare() for any pool
+// size or chunk size.
+inline Money parallelTotalFare(WorkStealingPool& pool, const RideStore& rides, size_t chunkRows = 65536) {
+    size_t chunks = (rides.size() + chunkRows - 1) / chunkRows;
+    std::vector<Money> partials(chunks);
+    pool.parallelFor(chunks, [&](size_t chunk) {
+        size_t first = chunk * chunkRows;
+        partials[chunk] = rides.totalFare(first, std::min(rides.size(), first + chunkRows));
+    });
+    Money total;
+    for (Money partial : partials) {
+        total += partial;
+    }
+    return total;
+}
+
+// MpscQueue - unbounded lock-free multi-producer / single-consumer queue
+// (Vyukov's node-based design). push() is one atomic exchange and never
+// blocks; pop() may only be called from the single consumer thread.
+template <typename T>
+class MpscQueue {
+private:
+    struct Node {
+        std::atomic<Node*> next{nullptr};
+        T value{};
+    };
+
+    alignas(64) std::atomic<Node*> head; // Most recently pushed node
+    alignas(64) Node* tail;              // Consumed dummy node
+
+public:
+    MpscQueue() : head(new Node), tail(head.load(std::memory_order_relaxed)) {}
+
+    ~MpscQueue() {
+        while (pop()) {
+        }
+        delete tail;
+    }
+
+    MpscQueue(const MpscQueue&) = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+
+    void push(T value) {
+        Node* node = new Node;
+        node->value = std::move(value);
+        Node* previous = head.exchange(node, std::memory_order_seq_cst); // Same instruction as acq_rel on x86
+        previous->next.store(node, std::memory_order_release);
+    }
+
+    // Consumer only: true when nothing has been pushed since the last pop,
+    // counting pushes still in progress. seq_cst, so a consumer that
+    // announces it is going to sleep and then finds the queue empty is
+    // ordered before any producer that misses the announcement.
+    bool empty() const { return head.load(std::memory_order_seq_cst) == tail; }
+
+    std::optional<T> pop() {
+        Node* next = tail->next.load(std::memory_order_acquire);
+        if (next == nullptr) {
+            return std::nullopt;
+        }
+        std::optional<T> value(std::move(next->value));
+        delete tail;
+        tail = next;
+        return value;
+    }
+};
+
+// A ride request as submitted by producer threads
+struct RideRequest {
+    int rideID = 0;
+    int driverID = 0;
+    RideType type = RideType::Standard;
+    LocationId pickup = 0;
+    LocationId dropoff = 0;
+    double distance = 0.0;
+    ZoneId pickupZone = 0; // Filled in by RideDispatcher::submit()
+};
+
+// RideDispatcher - concurrent ride ingestion
+// Drivers are partitioned into shards by driverID. Each shard owns its
+// drivers, its RideStore, its RideArena and an MPSC queue, and is drained
+// by exactly one worker thread, so driver state is never shared between
+// threads and there is no global lock: the one process-wide lookup a ride
+// needs, its pickup zone, is done by the producer in submit(). submit() may
+// be called from any number of producer threads.
+// A worker with nothing to do spins briefly, then parks on its shard's
+// flag (a futex wait), so idle shards cost no CPU. Past the zone lookup,
+// submit() is one exchange plus a plain load; it only makes a wake-up call
+// when the shard's worker is parked.
+class RideDispatcher {
+private:
+    static constexpr int idleSpins = 64; // Empty polls before a worker parks
+    // Under sustained load the queue may never drain, so snapshots are also
+    // published when this long has passed (checked every publishCheck rides)
+    static constexpr std::chrono::milliseconds publishInterval{1};
+    static constexpr size_t publishCheck = 256;
+
+    struct Shard {
+        MpscQueue<RideRequest> queue;
+        std::atomic<bool> parked{false}; // Worker is asleep, or about to be
+        RideArena arena; // Declared before rides so it outlives them
+        RideStore rides;
+        std::unordered_map<int, std::unique_ptr<Driver>> drivers;
+        std::vector<Driver*> stale; // Drivers with unpublished rides
+        // Written only by the worker, readable from any thread at any time
+        std::atomic<size_t> assigned{0};
+        std::atomic<size_t> rejected{0}; // Requests for drivers not in this shard
+        std::thread worker;
+    };
+
+    std::vector<std::unique_ptr<Shard>> shards;
+    std::atomic<bool> stopping{false};
+    bool running = false;
+
+    Shard& shardFor(int driverID) const {
+        return *shards[static_cast<size_t>(driverID) % shards.size()];
+    }
+
+    // Single-writer counter: a relaxed load and store, no locked instruction
+    static void increment(std::atomic<size_t>& counter) {
+        counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    void process(Shard& shard, const RideRequest& request) {
+        auto it = shard.drivers.find(request.driverID);
+        if (it == shard.drivers.end()) {
+            increment(shard.rejected);
+            return;
+        }
+        RideHandle ride = request.type == RideType::Premium
+            ? shard.rides.emplace<PremiumRide>(shard.arena, request.rideID, request.pickup, request.dropoff,
+                                               request.pickupZone, request.distance)
+            : shard.rides.emplace<StandardRide>(shard.arena, request.rideID, request.pickup, request.dropoff,
+                                                request.pickupZone, request.distance);
+        Driver& driver = *it->second;
+        if (!driver.isSnapshotStale()) {
+            shard.stale.push_back(&driver);
+        }
+        driver.addRide(ride);
+        increment(shard.assigned);
+    }
+
+    // One snapshot per driver for the whole batch, however many rides it took
+    static void publishSnapshots(Shard& shard) {
+        for (Driver* driver : shard.stale) {
+            driver->publishSnapshot();
+        }
+        shard.stale.clear();
+    }
+
+    void run(Shard& shard) {
+        int spins = 0;
+        size_t sinceCheck = 0;
+        auto lastPublish = std::chrono::steady_clock::now();
+        for (;;) {
+            if (auto request = shard.queue.pop()) {
+                process(shard, *request);
+                spins = 0;
+                if (++sinceCheck == publishCheck) {
+                    sinceCheck = 0;
+                    auto now = std::chrono::steady_clock::now();
+                    if (now - lastPublish >= publishInterval) {
+                        publishSnapshots(shard);
+                        lastPublish = now;
+                    }
+                }
+                continue;
+            }
+            if (!shard.stale.empty()) {
+                // Queue drained: the batch is complete
+                publishSnapshots(shard);
+                lastPublish = std::chrono::steady_clock::now();
+            }
+            if (stopping.load(std::memory_order_acquire)) {
+                // Producers are done; drain whatever is left, then exit
+                while (auto rest = shard.queue.pop()) {
+                    process(shard, *rest);
+                }
+                publishSnapshots(shard);
+                return;
+            } else if (++spins < idleSpins) {
+                std::this_thread::yield();
+            } else {
+                // Announce, then re-check: a producer either sees the flag
+                // and wakes us, or pushed before we looked (seq_cst on both)
+                shard.parked.store(true, std::memory_order_seq_cst);
+                if (shard.queue.empty() && !stopping.load(std::memory_order_seq_cst)) {
+                    shard.parked.wait(true, std::memory_order_acquire);
+                }
+                shard.parked.store(false, std::memory_order_relaxed);
+                spins = 0;
+            }
+        }
+    }
+
+    static void wake(Shard& shard) {
+        if (shard.parked.exchange(false, std::memory_order_seq_cst)) {
+            shard.parked.notify_one();
+        }
+    }
+
+public:
+    explicit RideDispatcher(size_t workerCount) {
+        if (workerCount == 0) {
+            throw std::invalid_argument("RideDispatcher: need at least one worker");
+        }
+        for (size_t i = 0; i < workerCount; ++i) {
+            shards.push_back(std::make_unique<Shard>());
+        }
+    }
+
+    ~RideDispatcher() { stop(); }
+
+    RideDispatcher(const RideDispatcher&) = delete;
+    RideDispatcher& operator=(const RideDispatcher&) = delete;
+
+    // Drivers must be registered before start()
+    Driver& addDriver(int id, std::string name, double rating) {
+        if (running) {
+            throw std::logic_error("RideDispatcher: cannot add drivers while running");
+        }
+        Shard& shard = shardFor(id);
+        auto driver = std::make_unique<Driver>(id, std::move(name), rating, shard.rides);
+        Driver& ref = *driver;
+        shard.drivers[id] = std::move(driver);
+        return ref;
+    }
+
+    void start() {
+        if (running) {
+            return;
+        }
+        stopping.store(false, std::memory_order_relaxed);
+        running = true;
+        for (auto& shard : shards) {
+            Shard* s = shard.get();
+            shard->worker = std::thread([this, s] { run(*s); });
+        }
+    }
+
+    // Thread safe; requests are queued to the shard owning the driver
+    void submit(RideRequest request) {
+        // Resolve the zone here, so workers never touch the LocationTable
+        request.pickupZone = LocationTable::shared().zone(request.pickup);
+        Shard& shard = shardFor(request.driverID);
+        shard.queue.push(request);
+        if (shard.parked.load(std::memory_order_seq_cst)) {
+            wake(shard);
+        }
+    }
+
+    // Processes every request submitted so far, then joins the workers.
+    // Call only after all producers have finished submitting.
+    void stop() {
+        if (!running) {
+            return;
+        }
+        stopping.store(true, std::memory_order_seq_cst);
+        for (auto& shard : shards) {
+            wake(*shard);
+            shard->worker.join();
+        }
+        running = false;
+    }
+
+    // Driver state may only be read while the dispatcher is stopped; snapshot()
+    // may be read at any time and is republished after each drained batch
+    const Driver* findDriver(int id) const {
+        const Shard& shard = shardFor(id);
+        auto it = shard.drivers.find(id);
+        return it == shard.drivers.end() ? nullptr : it->second.get();
+    }
+
+    // Safe while running; the counts then trail the rides still queued
+    size_t getAssignedCount() const {
+        size_t total = 0;
+        for (const auto& shard : shards) {
+            total += shard->assigned.load(std::memory_order_relaxed);
+        }
+        return total;
+    }
+
+    size_t getRejectedCount() const {
+        size_t total = 0;
+        for (const auto& shard : shards) {
+            total += shard->rejected.load(std::memory_order_relaxed);
+        }
+        return total;
+    }
+
+    size_t getWorkerCount() const { return shards.size(); }
+};
+
+// DriverLocator - spatial index for nearest-available-driver matching
+// Available drivers are bucketed into a uniform grid of square cells keyed
+// by packed cell coordinates. Position and availability updates move one
+// entry between cell buckets in O(1) (swap-remove), so the index is never
+// rebuilt. nearest() searches rings of cells outward from the query point
+// and stops once no unvisited ring can hold a closer driver, or once every
+// occupied cell has been scanned. When the next ring has more cells than
+// are left unscanned, it scans the remaining occupied cells directly
+// instead, so a query far from every driver costs O(occupied cells) rather
+// than a walk over the empty grid.
+class DriverLocator {
 private:
-    int rideID;
-    std::string pickupLocation;
-    std::string dropoffLocation;
+    struct Entry {
+        GeoPoint position;
+        std::int64_t cell = 0;
+        size_t slot = 0;        // Position within the cell bucket
+        bool available = false; // Only available drivers are bucketed
+    };
+
+    double cellSize;
+    std::unordered_map<int, Entry> drivers;
+    std::unordered_map<std::int64_t, std::vector<int>> cells;
+    size_t availableCount = 0;
+    std::int32_t minCellX = 0, maxCellX = 0, minCellY = 0, maxCellY = 0;
+
+    // Throws for coordinates that are not finite or whose cell does not fit
+    // in 32 bits, which the packed cell key cannot represent
+    std::int32_t cellCoord(double v) const {
+        double cell = std::floor(v / cellSize);
+        if (!std::isfinite(cell) || cell < std::numeric_limits<std::int32_t>::min() ||
+            cell > std::numeric_limits<std::int32_t>::max()) {
+            throw std::invalid_argument("DriverLocator: coordinate outside the grid");
+        }
+        return static_cast<std::int32_t>(cell);
+    }
+
+    static std::int64_t cellKey(std::int32_t cx, std::int32_t cy) {
+        return (static_cast<std::int64_t>(cx) << 32) | static_cast<std::uint32_t>(cy);
+    }
+
+    void link(int driverID, Entry& entry) {
+        std::int32_t cx = cellCoord(entry.position.x);
+        std::int32_t cy = cellCoord(entry.position.y);
+        if (availableCount == 0) {
+            minCellX = maxCellX = cx;
+            minCellY = maxCellY = cy;
+        } else {
+            minCellX = std::min(minCellX, cx);
+            maxCellX = std::max(maxCellX, cx);
+            minCellY = std::min(minCellY, cy);
+            maxCellY = std::max(maxCellY, cy);
+        }
+        entry.cell = cellKey(cx, cy);
+        std::vector<int>& bucket = cells[entry.cell];
+        entry.slot = bucket.size();
+        bucket.push_back(driverID);
+        ++availableCount;
+    }
+
+    void unlink(Entry& entry) {
+        auto it = cells.find(entry.cell);
+        std::vector<int>& bucket = it->second;
+        int moved = bucket.back();
+        bucket[entry.slot] = moved;
+        drivers.at(moved).slot = entry.slot;
+        bucket.pop_back();
+        if (bucket.empty()) {
+            cells.erase(it);
+        }
+        --availableCount;
+    }
+
+public:
+    explicit DriverLocator(double cellSizeMiles = 0.25) : cellSize(cellSizeMiles) {
+        if (!(cellSizeMiles > 0.0)) {
+            throw std::invalid_argument("DriverLocator: cell size must be positive");
+        }
+    }
+
+    // Adds a driver or moves an existing one. Rejects positions off the grid
+    // (see cellCoord) without changing the index.
+    void updatePosition(int driverID, GeoPoint position, bool available = true) {
+        const std::int64_t cell = cellKey(cellCoord(position.x), cellCoord(position.y));
+        auto [it, inserted] = drivers.try_emplace(driverID);
+        Entry& entry = it->second;
+        if (!inserted && entry.available) {
+            if (available && cell == entry.cell) {
+                entry.position = position; // Same cell: nothing to relink
+                return;
+            }
+            unlink(entry);
+        }
+        entry.position = position;
+        entry.available = available;
+        if (available) {
+            link(driverID, entry);
+        }
+    }
+
+    void setAvailable(int driverID, bool available) {
+        auto it = drivers.find(driverID);
+        if (it == drivers.end() || it->second.available == available) {
+            return;
+        }
+        if (available) {
+            link(driverID, it->second);
+        } else {
+            unlink(it->second);
+        }
+        it->second.available = available;
+    }
+
+    void remove(int driverID) {
+        auto it = drivers.find(driverID);
+        if (it == drivers.end()) {
+            return;
+        }
+        if (it->second.available) {
+            unlink(it->second);
+        }
+        drivers.erase(it);
+    }
+
+    // IDs of up to k available drivers closest to from, nearest first
+    std::vector<int> nearest(GeoPoint from, size_t k) const {
+        return nearest(from, k, [](int) { return true; });
+    }
+
+    // As above, counting only drivers for which accept(driverID) is true
+    template <typename Accept>
+    std::vector<int> nearest(GeoPoint from, size_t k, Accept accept) const {
+        std::vector<std::pair<double, int>> best; // Max-heap on squared distance
+        if (k == 0 || availableCount == 0) {
+            return {};
+        }
+        // The bounds only grow, so they may reach past the occupied cells;
+        // counting scanned cells ends the search at the last occupied one.
+        const std::int64_t cx = cellCoord(from.x);
+        const std::int64_t cy = cellCoord(from.y);
+        const std::int64_t maxRing = std::max({cx - minCellX, maxCellX - cx, cy - minCellY, maxCellY - cy, std::int64_t{0}});
+        size_t cellsScanned = 0;
+
+        auto scanBucket = [&](const std::vector<int>& bucket) {
+            ++cellsScanned;
+            for (int driverID : bucket) {
+                if (!accept(driverID)) {
+                    continue;
+                }
+                double d = squaredDistance(from, drivers.at(driverID).position);
+                if (best.size() < k) {
+                    best.emplace_back(d, driverID);
+                    std::push_heap(best.begin(), best.end());
+                } else if (d < best.front().first) {
+                    std::pop_heap(best.begin(), best.end());
+                    best.back() = {d, driverID};
+                    std::push_heap(best.begin(), best.end());
+                }
+            }
+        };
+
+        auto scanCell = [&](std::int64_t x, std::int64_t y) {
+            if (x < std::numeric_limits<std::int32_t>::min() || x > std::numeric_limits<std::int32_t>::max() ||
+                y < std::numeric_limits<std::int32_t>::min() || y > std::numeric_limits<std::int32_t>::max()) {
+                return;
+            }
+            auto it = cells.find(cellKey(static_cast<std::int32_t>(x), static_cast<std::int32_t>(y)));
+            if (it != cells.end()) {
+                scanBucket(it->second);
+            }
+        };
+
+        for (std::int64_t ring = 0; ring <= maxRing; ++ring) {
+            if (ring > 0 && static_cast<std::uint64_t>(ring) * 8 > cells.size() - cellsScanned) {
+                // Cheaper to visit what is left of the occupied cells, i.e.
+                // those at ring or beyond, than to probe this ring
+                for (const auto& [key, bucket] : cells) {
+                    std::int64_t x = static_cast<std::int32_t>(key >> 32);
+                    std::int64_t y = static_cast<std::int32_t>(static_cast<std::uint32_t>(key));
+                    if (std::max(std::abs(x - cx), std::abs(y - cy)) >= ring) {
+                        scanBucket(bucket);
+                    }
+                }
+                break;
+            }
+            if (ring == 0) {
+                scanCell(cx, cy);
+            } else {
+                for (std::int64_t x = cx - ring; x <= cx + ring; ++x) {
+                    scanCell(x, cy - ring);
+                    scanCell(x, cy + ring);
+                }
+                for (std::int64_t y = cy - ring + 1; y <= cy + ring - 1; ++y) {
+                    scanCell(cx - ring, y);
+                    scanCell(cx + ring, y);
+                }
+            }
+            // Every cell beyond this ring is at least ring * cellSize away
+            double reach = static_cast<double>(ring) * cellSize;
+            if ((best.size() == k && best.front().first <= reach * reach) || cellsScanned == cells.size()) {
+                break;
+            }
+        }
+
+        std::sort_heap(best.begin(), best.end());
+        std::vector<int> result;
+        result.reserve(best.size());
+        for (const auto& candidate : best) {
+            result.push_back(candidate.second);
+        }
+        return result;
+    }
+
+    bool isAvailable(int driverID) const {
+        auto it = drivers.find(driverID);
+        return it != drivers.end() && it->second.available;
+    }
+
+    size_t getAvailableCount() const { return availableCount; }
+    size_t size() const { return drivers.size(); }
+};
+
+// Tuning for RidePoolingMatcher
+struct PoolingOptions {
+    double pickupRadius = 1.0;  // Miles between pickups sharing a trip
+    double dropoffRadius = 2.0; // Miles between dropoffs sharing a trip
+    size_t maxSeats = 3;        // Rides per pooled trip
+    std::int64_t batchIntervalMs = 300;
+};
+
+// One driver trip serving one or more pooled rides
+struct PooledTrip {
+    int driverID;
+    std::vector<RideHandle> rides; // Seed ride first
+};
+
+// RidePoolingMatcher - groups compatible ride requests into shared trips.
+// Requests accumulate between micro-batches; each runBatch() groups the
+// pending ones greedily (oldest first as the seed, then any pending request
+// whose pickup and dropoff are close to the seed's and whose wait window
+// overlaps the group's) and hands each group to the nearest available
+// driver. Pickups are bucketed in a grid one pickup radius wide, so
+// finding companions only scans the 3 x 3 cells around the seed and a
+// batch costs O(pending) rather than O(pending^2). Requests that find no
+// driver stay pending until their window closes.
+class RidePoolingMatcher {
+private:
+    struct Request {
+        RideHandle ride;
+        GeoPoint pickup;
+        GeoPoint dropoff;
+        std::int64_t earliest; // Requested at, ms
+        std::int64_t latest;   // Last acceptable pickup time, ms
+    };
+
+    const RideStore& rides;
+    DriverLocator& locator;
+    PoolingOptions options;
+    std::unordered_map<int, Driver*> drivers;
+    std::vector<Request> pending; // In request order
+    std::int64_t lastBatchAt = std::numeric_limits<std::int64_t>::min();
+    size_t tripCount = 0;
+    size_t pooledRideCount = 0;
+    size_t expiredCount = 0;
+
+    std::int32_t cellCoord(double v) const { return static_cast<std::int32_t>(std::floor(v / options.pickupRadius)); }
+
+    static std::int64_t cellKey(std::int32_t cx, std::int32_t cy) {
+        return (static_cast<std::int64_t>(cx) << 32) | static_cast<std::uint32_t>(cy);
+    }
+
+public:
+    RidePoolingMatcher(const RideStore& store, DriverLocator& driverLocator, PoolingOptions poolingOptions = {})
+        : rides(store), locator(driverLocator), options(poolingOptions) {
+        if (options.pickupRadius <= 0.0 || options.maxSeats == 0) {
+            throw std::invalid_argument("RidePoolingMatcher: pickup radius and seats must be positive");
+        }
+    }
+
+    // Driver must also be positioned in the locator; it must outlive the
+    // matcher. Only added drivers are assigned trips.
+    void addDriver(Driver& driver) { drivers[driver.getDriverID()] = &driver; }
+
+    // Queues a ride for the next batch; it may wait up to maxWaitMs for pickup
+    void submit(RideHandle ride, std::int64_t nowMs, std::int64_t maxWaitMs) {
+        const Ride& r = rides.getRide(ride);
+        pending.push_back(Request{ride, r.getPickupPoint(), r.getDropoffPoint(), nowMs, nowMs + maxWaitMs});
+    }
+
+    // True once batchIntervalMs has passed since the last batch
+    bool batchDue(std::int64_t nowMs) const { return nowMs - lastBatchAt >= options.batchIntervalMs; }
+
+    // Matches the pending requests. Assigned drivers get every ride of
+    // their trip via Driver::addRide and are marked unavailable in the
+    // locator (mark them available again when the trip ends).
+    std::vector<PooledTrip> runBatch(std::int64_t nowMs) {
+        lastBatchAt = nowMs;
+        std::vector<PooledTrip> trips;
+        std::vector<Request> open;
+        open.reserve(pending.size());
+        for (const Request& request : pending) {
+            if (request.latest < nowMs) {
+                ++expiredCount;
+            } else {
+                open.push_back(request);
+            }
+        }
+
+        std::unordered_map<std::int64_t, std::vector<size_t>> cells;
+        for (size_t i = 0; i < open.size(); ++i) {
+            cells[cellKey(cellCoord(open[i].pickup.x), cellCoord(open[i].pickup.y))].push_back(i);
+        }
+        std::vector<char> grouped(open.size(), 0);
+        std::vector<Request> unmatched;
+        const double pickupLimit = options.pickupRadius * options.pickupRadius;
+        const double dropoffLimit = options.dropoffRadius * options.dropoffRadius;
+
+        for (size_t seed = 0; seed < open.size(); ++seed) {
+            if (grouped[seed]) {
+                continue;
+            }
+            if (locator.getAvailableCount() == 0) {
+                unmatched.push_back(open[seed]); // Fleet exhausted: the rest wait
+                continue;
+            }
+            const Request& first = open[seed];
+            std::vector<size_t> group{seed};
+            std::int64_t earliest = first.earliest;
+            std::int64_t latest = first.latest;
+            const std::int32_t cx = cellCoord(first.pickup.x);
+            const std::int32_t cy = cellCoord(first.pickup.y);
+            std::vector<size_t> candidates;
+            for (std::int32_t x = cx - 1; x <= cx + 1; ++x) {
+                for (std::int32_t y = cy - 1; y <= cy + 1; ++y) {
+                    auto it = cells.find(cellKey(x, y));
+                    if (it != cells.end()) {
+                        candidates.insert(candidates.end(), it->second.begin(), it->second.end());
+                    }
+                }
+            }
+            std::sort(candidates.begin(), candidates.end()); // Oldest companions first
+            for (size_t other : candidates) {
+                if (group.size() == options.maxSeats) {
+                    break;
+                }
+                const Request& candidate = open[other];
+                if (other == seed || grouped[other] ||
+                    squaredDistance(first.pickup, candidate.pickup) > pickupLimit ||
+                    squaredDistance(first.dropoff, candidate.dropoff) > dropoffLimit ||
+                    std::max(earliest, candidate.earliest) > std::min(latest, candidate.latest)) {
+                    continue;
+                }
+                group.push_back(other);
+                earliest = std::max(earliest, candidate.earliest);
+                latest = std::min(latest, candidate.latest);
+            }
+
+            // The locator may also hold drivers outside this pool
+            std::vector<int> nearest = locator.nearest(first.pickup, 1, [this](int driverID) { return drivers.contains(driverID); });
+            if (nearest.empty()) {
+                unmatched.push_back(first); // Companions may still seed their own trips
+                grouped[seed] = 1;
+                continue;
+            }
+            auto driver = drivers.find(nearest.front());
+            PooledTrip trip{driver->first, {}};
+            for (size_t member : group) {
+                grouped[member] = 1;
+                trip.rides.push_back(open[member].ride);
+                driver->second->addRide(open[member].ride);
+            }
+            locator.setAvailable(driver->first, false);
+            ++tripCount;
+            pooledRideCount += trip.rides.size();
+            trips.push_back(std::move(trip));
+        }
+        pending = std::move(unmatched);
+        for (const PooledTrip& trip : trips) {
+            drivers.at(trip.driverID)->publishSnapshot(); // Once per driver per round
+        }
+        return trips;
+    }
+
+    size_t getPendingCount() const { return pending.size(); }
+    size_t getTripCount() const { return tripCount; }
+    size_t getMatchedRideCount() const { return pooledRideCount; }
+    size_t getExpiredCount() const { return expiredCount; }
+};
+
+// Task<T> - lazily started coroutine returning T.
+// The body runs when the task is first awaited; on completion it resumes
+// its awaiter directly (symmetric transfer), so chains of co_awaits do not
+// grow the stack. Exceptions thrown in the body are rethrown at co_await.
+template <typename T = void>
+class Task;
+
+namespace detail {
+
+template <typename T>
+struct TaskPromiseBase {
+    std::coroutine_handle<> continuation;
+    std::exception_ptr error;
+
+    std::suspend_always initial_suspend() noexcept { return {}; }
+
+    struct FinalAwaiter {
+        bool await_ready() noexcept { return false; }
+        template <typename Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> done) noexcept {
+            std::coroutine_handle<> next = done.promise().continuation;
+            return next ? next : std::noop_coroutine();
+        }
+        void await_resume() noexcept {}
+    };
+    FinalAwaiter final_suspend() noexcept { return {}; }
+
+    void unhandled_exception() { error = std::current_exception(); }
+
+    void rethrowIfFailed() {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+};
+
+template <typename T>
+struct TaskPromise : TaskPromiseBase<T> {
+    std::optional<T> value;
+
+    Task<T> get_return_object();
+    void return_value(T result) { value.emplace(std::move(result)); }
+    T result() {
+        this->rethrowIfFailed();
+        return std::move(*value);
+    }
+};
+
+template <>
+struct TaskPromise<void> : TaskPromiseBase<void> {
+    Task<void> get_return_object();
+    void return_void() {}
+    void result() { rethrowIfFailed(); }
+};
+
+} // namespace detail
+
+template <typename T>
+class Task {
+public:
+    using promise_type = detail::TaskPromise<T>;
+
+private:
+    std::coroutine_handle<promise_type> handle;
+
+public:
+    explicit Task(std::coroutine_handle<promise_type> coroutine) : handle(coroutine) {}
+    Task(Task&& other) noexcept : handle(std::exchange(other.handle, {})) {}
+    Task& operator=(Task&& other) noexcept {
+        if (this != &other) {
+            if (handle) {
+                handle.destroy();
+            }
+            handle = std::exchange(other.handle, {});
+        }
+        return *this;
+    }
+    ~Task() {
+        if (handle) {
+            handle.destroy();
+        }
+    }
+
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+    auto operator co_await() && noexcept {
+        struct Awaiter {
+            std::coroutine_handle<promise_type> task;
+            bool await_ready() noexcept { return task.done(); }
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+                task.promise().continuation = awaiting;
+                return task;
+            }
+            T await_resume() { return task.promise().result(); }
+        };
+        return Awaiter{handle};
+    }
+};
+
+namespace detail {
+
+template <typename T>
+Task<T> TaskPromise<T>::get_return_object() {
+    return Task<T>(std::coroutine_handle<TaskPromise<T>>::from_promise(*this));
+}
+
+inline Task<void> TaskPromise<void>::get_return_object() {
+    return Task<void>(std::coroutine_handle<TaskPromise<void>>::from_promise(*this));
+}
+
+} // namespace detail
+
+// EventLoop - single-threaded epoll reactor that resumes coroutines.
+// Coroutines suspend on a timer (sleepFor) or on fd readiness
+// (readable/writable) and are resumed from run() when the timer expires
+// or epoll reports the fd. Timers are kept in a min-heap behind one
+// timerfd, so any number of waits costs one kernel wakeup per deadline.
+// Not thread safe: spawn and await only from the loop's thread.
+class EventLoop {
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Timer {
+        Clock::time_point deadline;
+        std::uint64_t sequence; // Keeps equal deadlines in FIFO order
+        std::coroutine_handle<> waiter;
+        bool operator>(const Timer& other) const {
+            return deadline != other.deadline ? deadline > other.deadline : sequence > other.sequence;
+        }
+    };
+
+    // Top-level coroutine owning a spawned task; destroys itself when done
+    struct Detached {
+        struct promise_type {
+            Detached get_return_object() { return {}; }
+            std::suspend_never initial_suspend() noexcept { return {}; }
+            std::suspend_never final_suspend() noexcept { return {}; }
+            void return_void() {}
+            void unhandled_exception() { std::terminate(); }
+        };
+    };
+
+    int epollFd;
+    int timerFd;
+    std::priority_queue<Timer, std::vector<Timer>, std::greater<>> timers;
+    Clock::time_point armedDeadline = Clock::time_point::max();
+    std::uint64_t timerSequence = 0;
+    size_t liveTasks = 0;
+    size_t fdWaits = 0;
+    std::exception_ptr failure; // First exception escaping a spawned task
+
+    static Detached drive(EventLoop& loop, Task<void> task) {
+        try {
+            co_await std::move(task);
+        } catch (...) {
+            if (!loop.failure) {
+                loop.failure = std::current_exception();
+            }
+        }
+        --loop.liveTasks;
+    }
+
+    void armTimer() {
+        Clock::time_point next = timers.empty() ? Clock::time_point::max() : timers.top().deadline;
+        if (next == armedDeadline) {
+            return;
+        }
+        itimerspec spec{};
+        if (next != Clock::time_point::max()) {
+            // steady_clock is CLOCK_MONOTONIC on Linux
+            auto since = std::chrono::duration_cast<std::chrono::nanoseconds>(next.time_since_epoch()).count();
+            spec.it_value.tv_sec = static_cast<time_t>(since / 1000000000);
+            spec.it_value.tv_nsec = static_cast<long>(since % 1000000000);
+        }
+        if (::timerfd_settime(timerFd, TFD_TIMER_ABSTIME, &spec, nullptr) < 0) {
+            throw std::system_error(errno, std::generic_category(), "EventLoop: cannot arm timer");
+        }
+        armedDeadline = next;
+    }
+
+    void fireTimers() {
+        Clock::time_point now = Clock::now();
+        while (!timers.empty() && timers.top().deadline <= now) {
+            std::coroutine_handle<> waiter = timers.top().waiter;
+            timers.pop();
+            waiter.resume();
+        }
+    }
+
+    struct FdAwaiter {
+        EventLoop& loop;
+        int fd;
+        std::uint32_t events;
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> waiter) {
+            epoll_event event{};
+            event.events = events | EPOLLONESHOT;
+            event.data.ptr = waiter.address();
+            if (::epoll_ctl(loop.epollFd, EPOLL_CTL_ADD, fd, &event) < 0) {
+                throw std::system_error(errno, std::generic_category(), "EventLoop: cannot watch fd");
+            }
+            ++loop.fdWaits;
+        }
+        void await_resume() const {
+            --loop.fdWaits;
+            ::epoll_ctl(loop.epollFd, EPOLL_CTL_DEL, fd, nullptr);
+        }
+    };
+
+public:
+    EventLoop()
+        : epollFd(::epoll_create1(EPOLL_CLOEXEC)),
+          timerFd(::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)) {
+        if (epollFd < 0 || timerFd < 0) {
+            int error = errno;
+            if (epollFd >= 0) {
+                ::close(epollFd);
+            }
+            if (timerFd >= 0) {
+                ::close(timerFd);
+            }
+            throw std::system_error(error, std::generic_category(), "EventLoop: cannot create epoll/timerfd");
+        }
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.ptr = nullptr; // The timerfd; coroutine waits carry their handle
+        ::epoll_ctl(epollFd, EPOLL_CTL_ADD, timerFd, &event);
+    }
+
+    ~EventLoop() {
+        ::close(timerFd);
+        ::close(epollFd);
+    }
+
+    EventLoop(const EventLoop&) = delete;
+    EventLoop& operator=(const EventLoop&) = delete;
+
+    // Starts a task now (it runs until its first suspension); run() drives
+    // it to completion
+    void spawn(Task<void> task) {
+        ++liveTasks;
+        drive(*this, std::move(task));
+    }
+
+    // Resumes the awaiting coroutine from run() once the delay has passed
+    auto sleepFor(Clock::duration delay) {
+        struct Awaiter {
+            EventLoop& loop;
+            Clock::time_point deadline;
+            bool await_ready() const noexcept { return deadline <= Clock::now(); }
+            void await_suspend(std::coroutine_handle<> waiter) {
+                loop.timers.push(Timer{deadline, loop.timerSequence++, waiter});
+            }
+            void await_resume() const noexcept {}
+        };
+        return Awaiter{*this, Clock::now() + delay};
+    }
+
+    // Resumes the awaiting coroutine once fd is readable / writable. One
+    // waiter per fd at a time.
+    FdAwaiter readable(int fd) { return FdAwaiter{*this, fd, EPOLLIN}; }
+    FdAwaiter writable(int fd) { return FdAwaiter{*this, fd, EPOLLOUT}; }
+
+    // Runs until every spawned task has finished, then rethrows the first
+    // exception that escaped one of them
+    void run() {
+        std::array<epoll_event, 256> events;
+        while (liveTasks > 0) {
+            fireTimers();
+            if (liveTasks == 0) {
+                break;
+            }
+            if (timers.empty() && fdWaits == 0) {
+                throw std::logic_error("EventLoop: tasks are suspended with no timer or fd to wake them");
+            }
+            armTimer();
+            int ready = ::epoll_wait(epollFd, events.data(), static_cast<int>(events.size()), -1);
+            if (ready < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw std::system_error(errno, std::generic_category(), "EventLoop: epoll_wait failed");
+            }
+            for (int i = 0; i < ready; ++i) {
+                if (events[i].data.ptr == nullptr) {
+                    std::uint64_t expirations;
+                    (void)::read(timerFd, &expirations, sizeof(expirations));
+                    armedDeadline = Clock::time_point::max();
+                } else {
+                    std::coroutine_handle<>::from_address(events[i].data.ptr).resume();
+                }
+            }
+        }
+        if (failure) {
+            std::rethrow_exception(std::exchange(failure, nullptr));
+        }
+    }
+
+    size_t getLiveTaskCount() const { return liveTasks; }
+};
+
+// Simulated round-trip time of each remote step of a ride request
+struct AsyncRideOptions {
+    std::chrono::microseconds pricingLatency{2000};  // Surge/pricing service
+    std::chrono::microseconds matchingLatency{2000}; // Driver matching service
+    std::chrono::microseconds persistLatency{2000};  // Durable write of the assignment
+};
+
+// Outcome of one ride request
+struct AsyncRideResult {
+    RideHandle ride;
+    int driverID = 0; // 0 when no driver was available
+    Money fare;
+};
+
+// AsyncRideDispatcher - coroutine ride request path on an EventLoop:
+//   RideRequest request; ...
+//   AsyncRideResult result = co_await dispatcher.request(rider, request);
+// Each request prices the ride, matches a driver and persists the
+// assignment, awaiting a round trip before each step. While one request
+// waits the loop runs the others, so one thread keeps thousands in flight
+// and, since every step runs on the loop thread, the store, locator and
+// drivers need no locking. The steps are public so a blocking
+// (thread-per-request) caller can run the same work under its own lock.
+class AsyncRideDispatcher {
+private:
+    EventLoop& loop;
+    RideStore& rides;
+    RideArena& arena;
+    DriverLocator& locator;
+    AsyncRideOptions options;
+    std::unordered_map<int, Driver*> drivers;
+
+public:
+    AsyncRideDispatcher(EventLoop& eventLoop, RideStore& store, RideArena& rideArena, DriverLocator& driverLocator,
+                        AsyncRideOptions asyncOptions = {})
+        : loop(eventLoop), rides(store), arena(rideArena), locator(driverLocator), options(asyncOptions) {}
+
+    // Driver must also be positioned in the locator; it must outlive the
+    // dispatcher. Only added drivers are assigned rides.
+    void addDriver(Driver& driver) { drivers[driver.getDriverID()] = &driver; }
+
+    // Creates the ride and prices it against the current surge table
+    AsyncRideResult price(const RideRequest& request) {
+        AsyncRideResult result;
+        result.ride = request.type == RideType::Premium
+            ? rides.emplace<PremiumRide>(arena, request.rideID, request.pickup, request.dropoff, request.distance)
+            : rides.emplace<StandardRide>(arena, request.rideID, request.pickup, request.dropoff, request.distance);
+        result.fare = rides.chargeAt(result.ride);
+        return result;
+    }
+
+    // Reserves the requested driver if it is one of ours and available,
+    // otherwise the nearest available one of ours. Leaves driverID 0 if
+    // none is available.
+    void match(const RideRequest& request, AsyncRideResult& result) {
+        int driverID = request.driverID;
+        if (driverID == 0 || !drivers.contains(driverID) || !locator.isAvailable(driverID)) {
+            // The locator may also hold drivers outside this dispatcher
+            std::vector<int> nearest = locator.nearest(rides.getRide(result.ride).getPickupPoint(), 1,
+                                                       [this](int id) { return drivers.contains(id); });
+            driverID = nearest.empty() ? 0 : nearest.front();
+        }
+        if (driverID != 0) {
+            locator.setAvailable(driverID, false);
+            result.driverID = driverID;
+        }
+    }
+
+    // Records the assignment with the driver and the rider (notifying
+    // their listeners), or drops the ride if no driver was matched
+    void commit(Rider& rider, AsyncRideResult& result) {
+        if (result.driverID == 0) {
+            rides.remove(result.ride);
+            return;
+        }
+        Driver& driver = *drivers.at(result.driverID);
+        driver.addRide(result.ride);
+        rider.addRide(result.ride);
+        driver.publishSnapshot();
+        rider.publishSnapshot();
+    }
+
+    // Awaitable request; the rider must outlive the returned task
+    Task<AsyncRideResult> request(Rider& rider, RideRequest request) {
+        co_await loop.sleepFor(options.pricingLatency);
+        AsyncRideResult result = price(request);
+        co_await loop.sleepFor(options.matchingLatency);
+        match(request, result);
+        co_await loop.sleepFor(options.persistLatency);
+        commit(rider, result);
+        co_return result;
+    }
+
+    const AsyncRideOptions& getOptions() const { return options; }
+};
+
+// Ride ledger - compact, versioned binary ride log designed to be mmap'ed
+// and queried in place, without deserialization. Layout (native
+// little-endian, all offsets from the start of the file):
+//   LedgerHeader
+//   LedgerRecord[recordCount]               fixed 48-byte records
+//   LedgerString[locationCount]             location index
+//   char[]                                  location names (not terminated)
+// Records refer to locations by their index in the ledger's own location
+// table, so a ledger stays readable after the process's LocationTable is gone.
+static_assert(std::endian::native == std::endian::little, "ride ledger format is little-endian");
+
+struct LedgerHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t recordSize;
+    std::uint64_t recordCount;
+    std::uint64_t recordsOffset;
+    std::uint64_t locationCount;
+    std::uint64_t locationIndexOffset;
+    std::uint64_t locationDataOffset;
+    std::uint64_t fileSize;
+};
+
+struct LedgerRecord {
+    std::int32_t rideID;
+    RideType type;
+    std::uint8_t reserved[3];
+    std::uint32_t pickup;   // Ledger location index
+    std::uint32_t dropoff;  // Ledger location index
     double distance;
+    double baseFareRate;
+    double luxuryMultiplier;
+    double surgeMultiplier;
+
+    double fare() const { return distance * baseFareRate * luxuryMultiplier * surgeMultiplier; }
+};
+
+struct LedgerString {
+    std::uint64_t offset; // From locationDataOffset
+    std::uint32_t length;
+    std::uint32_t reserved;
+};
+
+static_assert(sizeof(LedgerRecord) == 48 && std::is_trivially_copyable_v<LedgerRecord>);
+static_assert(sizeof(LedgerString) == 16 && std::is_trivially_copyable_v<LedgerString>);
+
+constexpr char ledgerMagic[8] = {'R', 'I', 'D', 'E', 'L', 'O', 'G', '\0'};
+constexpr std::uint32_t ledgerVersion = 2; // 2: records carry the surge multiplier
+
+// Writes every live ride in the store to path. The file is written next to
+// path, synced and renamed into place, and the directory is synced after
+// the rename, so neither readers nor a crash can leave a partial ledger.
+// If writing fails the temporary file is removed.
+void writeRideLedger(const std::string& path, const RideStore& rides) {
+    std::vector<LedgerRecord> records;
+    std::vector<LocationId> locations; // Ledger index -> LocationTable id
+    std::unordered_map<LocationId, std::uint32_t> ledgerIndex;
+    auto localId = [&](LocationId id) {
+        auto [it, inserted] = ledgerIndex.try_emplace(id, static_cast<std::uint32_t>(locations.size()));
+        if (inserted) {
+            locations.push_back(id);
+        }
+        return it->second;
+    };
+
+    records.reserve(rides.size());
+    for (RideStore::Index row = 0; row < rides.size(); ++row) {
+        if (!rides.isLive(row)) {
+            continue;
+        }
+        const Ride& ride = rides.getRide(rides.handleAt(row));
+        LedgerRecord record{};
+        record.rideID = ride.getRideID();
+        record.type = ride.getTypeTag();
+        record.pickup = localId(ride.getPickupLocationId());
+        record.dropoff = localId(ride.getDropoffLocationId());
+        record.distance = ride.getDistance();
+        record.baseFareRate = ride.getBaseFareRate();
+        record.luxuryMultiplier = ride.getLuxuryMultiplier();
+        record.surgeMultiplier = ride.getSurgeMultiplier();
+        records.push_back(record);
+    }
+
+    std::vector<LedgerString> index;
+    std::string names;
+    for (LocationId id : locations) {
+        std::string_view name = LocationTable::shared().name(id);
+        index.push_back(LedgerString{names.size(), static_cast<std::uint32_t>(name.size()), 0});
+        names.append(name);
+    }
+
+    LedgerHeader header{};
+    std::copy(std::begin(ledgerMagic), std::end(ledgerMagic), header.magic);
+    header.version = ledgerVersion;
+    header.recordSize = sizeof(LedgerRecord);
+    header.recordCount = records.size();
+    header.recordsOffset = sizeof(LedgerHeader);
+    header.locationCount = index.size();
+    header.locationIndexOffset = header.recordsOffset + records.size() * sizeof(LedgerRecord);
+    header.locationDataOffset = header.locationIndexOffset + index.size() * sizeof(LedgerString);
+    header.fileSize = header.locationDataOffset + names.size();
+
+    auto bytes = [](const auto& data, size_t count) {
+        return std::string_view(reinterpret_cast<const char*>(data), count * sizeof(*data));
+    };
+    const std::string temporary = path + ".tmp";
+    try {
+        FdSink file(temporary);
+        file.write(bytes(&header, 1));
+        file.write(bytes(records.data(), records.size()));
+        file.write(bytes(index.data(), index.size()));
+        file.write(names);
+        file.sync(); // The data must be durable before the name points at it
+        if (std::rename(temporary.c_str(), path.c_str()) != 0) {
+            throw std::system_error(errno, std::generic_category(), "writeRideLedger: cannot rename " + temporary);
+        }
+    } catch (...) {
+        std::remove(temporary.c_str());
+        throw;
+    }
+    std::string directory = std::filesystem::path(path).parent_path().string();
+    if (directory.empty()) {
+        directory = ".";
+    }
+    int directoryFd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (directoryFd < 0) {
+        throw std::system_error(errno, std::generic_category(), "writeRideLedger: cannot open " + directory);
+    }
+    FdSink(directoryFd, true).sync(); // Makes the rename itself durable
+}
+
+// MappedRideLedger - read-only view of a ledger file mapped into memory.
+// Opening validates the header, the section bounds and each record's ride
+// type and location indices; after that every query reads the mapped pages
+// directly.
+class MappedRideLedger {
+private:
+    const char* base = nullptr;
+    size_t length = 0;
+    const LedgerHeader* header = nullptr;
+
+    [[noreturn]] static void corrupt(const std::string& path, const char* what) {
+        throw std::runtime_error("MappedRideLedger: " + path + ": " + what);
+    }
+
+public:
+    explicit MappedRideLedger(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            throw std::system_error(errno, std::generic_category(), "MappedRideLedger: cannot open " + path);
+        }
+        struct stat info {};
+        if (::fstat(fd, &info) != 0) {
+            int error = errno;
+            ::close(fd);
+            throw std::system_error(error, std::generic_category(), "MappedRideLedger: cannot stat " + path);
+        }
+        length = static_cast<size_t>(info.st_size);
+        if (length < sizeof(LedgerHeader)) {
+            ::close(fd);
+            corrupt(path, "file too small");
+        }
+        void* mapping = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        int error = errno;
+        ::close(fd); // The mapping keeps the file referenced
+        if (mapping == MAP_FAILED) {
+            throw std::system_error(error, std::generic_category(), "MappedRideLedger: cannot map " + path);
+        }
+        base = static_cast<const char*>(mapping);
+        header = reinterpret_cast<const LedgerHeader*>(base);
+
+        // A section of count items of type T at offset: after the previous
+        // section, aligned for T (the mapping itself is page aligned) and
+        // inside the file. Written so that no header value can overflow it.
+        auto sectionFits = [this](std::uint64_t offset, std::uint64_t count, size_t size, size_t alignment,
+                                  std::uint64_t previousEnd) {
+            return offset >= previousEnd && offset <= length && offset % alignment == 0 &&
+                   count <= (length - offset) / size;
+        };
+        const char* problem = nullptr;
+        if (!std::equal(std::begin(ledgerMagic), std::end(ledgerMagic), header->magic)) {
+            problem = "bad magic";
+        } else if (header->version != ledgerVersion) {
+            problem = "unsupported version";
+        } else if (header->recordSize != sizeof(LedgerRecord)) {
+            problem = "unexpected record size";
+        } else if (header->fileSize != length ||
+                   !sectionFits(header->recordsOffset, header->recordCount, sizeof(LedgerRecord),
+                                alignof(LedgerRecord), sizeof(LedgerHeader)) ||
+                   !sectionFits(header->locationIndexOffset, header->locationCount, sizeof(LedgerString),
+                                alignof(LedgerString),
+                                header->recordsOffset + header->recordCount * sizeof(LedgerRecord)) ||
+                   !sectionFits(header->locationDataOffset, 0, 1, 1,
+                                header->locationIndexOffset + header->locationCount * sizeof(LedgerString))) {
+            problem = "section out of bounds";
+        } else {
+            for (const LedgerRecord& record : records()) {
+                if (static_cast<size_t>(record.type) >= rideTypeCount || record.pickup >= header->locationCount ||
+                    record.dropoff >= header->locationCount) {
+                    problem = "invalid ride record";
+                    break;
+                }
+            }
+        }
+        if (problem != nullptr) {
+            ::munmap(const_cast<char*>(base), length);
+            corrupt(path, problem);
+        }
+    }
+
+    ~MappedRideLedger() {
+        if (base != nullptr) {
+            ::munmap(const_cast<char*>(base), length);
+        }
+    }
+
+    MappedRideLedger(const MappedRideLedger&) = delete;
+    MappedRideLedger& operator=(const MappedRideLedger&) = delete;
+
+    std::span<const LedgerRecord> records() const {
+        return {reinterpret_cast<const LedgerRecord*>(base + header->recordsOffset), header->recordCount};
+    }
+
+    std::string_view locationName(std::uint32_t index) const {
+        if (index >= header->locationCount) {
+            throw std::out_of_range("MappedRideLedger: location index out of range");
+        }
+        const LedgerString& entry = reinterpret_cast<const LedgerString*>(base + header->locationIndexOffset)[index];
+        std::uint64_t dataLength = length - header->locationDataOffset;
+        if (entry.offset > dataLength || entry.length > dataLength - entry.offset) {
+            throw std::runtime_error("MappedRideLedger: location name out of bounds");
+        }
+        return {base + header->locationDataOffset + entry.offset, entry.length};
+    }
+
+    Money totalFare() const {
+        Money total;
+        for (const LedgerRecord& record : records()) {
+            total += Money::fromDollars(record.fare());
+        }
+        return total;
+    }
+
+    size_t size() const { return header->recordCount; }
+    size_t getLocationCount() const { return header->locationCount; }
+};
+
+// Recreates every ride of a ledger in rides (from arena), at the surge
+// multiplier it was charged at, and returns their handles in ledger order.
+// The ledger does not record drivers or riders, so the caller attaches the
+// rides with Driver::restoreRide / Rider::restoreRide.
+std::vector<RideHandle> loadRideLedger(const MappedRideLedger& ledger, RideArena& arena, RideStore& rides) {
+    std::vector<LocationId> locations(ledger.getLocationCount()); // Ledger index -> LocationTable id
+    for (std::uint32_t i = 0; i < locations.size(); ++i) {
+        locations[i] = LocationTable::shared().intern(ledger.locationName(i));
+    }
+    std::vector<RideHandle> loaded;
+    loaded.reserve(ledger.size());
+    rides.reserve(rides.size() + ledger.size());
+    int lastRideID = 0;
+    for (const LedgerRecord& record : ledger.records()) {
+        LocationId pickup = locations[record.pickup];
+        LocationId dropoff = locations[record.dropoff];
+        RidePtr ride = record.type == RideType::Premium
+            ? arena.make<PremiumRide>(record.rideID, pickup, dropoff, record.distance)
+            : arena.make<StandardRide>(record.rideID, pickup, dropoff, record.distance);
+        ride->setSurgeMultiplier(record.surgeMultiplier); // Charged then, not now
+        loaded.push_back(rides.add(std::move(ride)));
+        lastRideID = std::max(lastRideID, record.rideID);
+    }
+    rideIDSequence().advancePast(lastRideID); // Loaded IDs are taken
+    return loaded;
+}
+
+// Bulk import of ride, driver and rider records from CSV dumps:
+//   driver,<id>,<name>,<rating>
+//   rider,<id>,<name>
+//   ride,<id>,<Standard|Premium>,<pickup>,<dropoff>,<distance>,<driverID>,<riderID>
+// Fields are not quoted and may not contain commas; a '\r' before the
+// newline is ignored. Drivers and riders must appear before their rides.
+
+// Bitmask of the ',' and '\n' bytes among the 64 bytes at p
+inline std::uint64_t csvDelimiterMask(const char* p) {
+#if defined(__AVX2__)
+    const __m256i comma = _mm256_set1_epi8(',');
+    const __m256i newline = _mm256_set1_epi8('\n');
+    __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+    __m256i hi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 32));
+    auto mask = [&](__m256i bytes) {
+        __m256i hits = _mm256_or_si256(_mm256_cmpeq_epi8(bytes, comma), _mm256_cmpeq_epi8(bytes, newline));
+        return static_cast<std::uint32_t>(_mm256_movemask_epi8(hits));
+    };
+    return mask(lo) | (static_cast<std::uint64_t>(mask(hi)) << 32);
+#elif defined(__SSE2__)
+    const __m128i comma = _mm_set1_epi8(',');
+    const __m128i newline = _mm_set1_epi8('\n');
+    std::uint64_t result = 0;
+    for (int i = 0; i < 4; ++i) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 16 * i));
+        __m128i hits = _mm_or_si128(_mm_cmpeq_epi8(bytes, comma), _mm_cmpeq_epi8(bytes, newline));
+        result |= static_cast<std::uint64_t>(static_cast<std::uint16_t>(_mm_movemask_epi8(hits))) << (16 * i);
+    }
+    return result;
+#else
+    std::uint64_t result = 0;
+    for (int i = 0; i < 64; ++i) {
+        result |= static_cast<std::uint64_t>(p[i] == ',' || p[i] == '\n') << i;
+    }
+    return result;
+#endif
+}
+
+// Splits data into records and calls onRecord(fields) for each non-blank
+// line. Delimiters are found 64 bytes at a time and walked as set bits, so
+// field contents are never inspected byte by byte. Fields are views into
+// data; a record with more than maxCsvFields fields is passed truncated to
+// maxCsvFields + 1 so the caller can reject it.
+constexpr size_t maxCsvFields = 8;
+
+template <typename OnRecord>
+void forEachCsvRecord(std::string_view data, OnRecord&& onRecord) {
+    std::array<std::string_view, maxCsvFields + 1> fields;
+    size_t fieldCount = 0;
+    size_t fieldStart = 0;
+    auto endField = [&](size_t end, bool endOfLine) {
+        bool stored = fieldCount < fields.size();
+        if (stored) {
+            fields[fieldCount++] = data.substr(fieldStart, end - fieldStart);
+        }
+        fieldStart = end + 1;
+        if (endOfLine) {
+            std::string_view& last = fields[fieldCount - 1];
+            if (stored && !last.empty() && last.back() == '\r') {
+                last.remove_suffix(1);
+            }
+            if (fieldCount > 1 || !fields[0].empty()) {
+                onRecord(std::span<const std::string_view>(fields.data(), fieldCount));
+            }
+            fieldCount = 0;
+        }
+    };
+    auto walk = [&](size_t blockStart, std::uint64_t mask) {
+        while (mask != 0) {
+            size_t pos = blockStart + static_cast<size_t>(std::countr_zero(mask));
+            endField(pos, data[pos] == '\n');
+            mask &= mask - 1;
+        }
+    };
+
+    size_t pos = 0;
+    for (; pos + 64 <= data.size(); pos += 64) {
+        walk(pos, csvDelimiterMask(data.data() + pos));
+    }
+    if (pos < data.size()) {
+        // Tail: scan a zero-padded copy (NUL is never a delimiter)
+        alignas(64) char tail[64] = {};
+        std::memcpy(tail, data.data() + pos, data.size() - pos);
+        walk(pos, csvDelimiterMask(tail));
+    }
+    if (fieldStart < data.size() || fieldCount > 0) {
+        endField(data.size(), true); // Last line without a trailing newline
+    }
+}
+
+// Result of a bulk import. Drivers and riders are in file order and read
+// from the store the rides were imported into.
+struct RideImport {
+    std::vector<std::unique_ptr<Driver>> drivers;
+    std::vector<std::unique_ptr<Rider>> riders;
+    std::vector<RideHandle> rides;
+    size_t malformedRecords = 0; // Also counts records repeating an earlier ID
+};
+
+// One pass over data: rides are constructed straight into arena storage
+// and the store, then attached to their driver and rider without
+// notifying listeners. Fields are parsed in place with from_chars; the
+// only copies are driver/rider names and each distinct location name,
+// which is interned, and its zone looked up, once, so building a ride
+// does not touch the LocationTable. A ride, driver or rider whose ID
+// already appeared in the input is rejected like a malformed record.
+// Snapshots are published once, at the end.
+// Only the delimiter scan runs at GB/s (csv_split in --bench); end to end
+// (bulk_import, --import) the cost is dominated by building each ride
+// object, its store row and two history entries, and by number parsing.
+RideImport importRideRecords(std::string_view data, RideArena& arena, RideStore& store) {
+    struct KnownLocation {
+        LocationId id;
+        ZoneId zone;
+    };
+    RideImport result;
+    std::unordered_map<int, Driver*> drivers;
+    std::unordered_map<int, Rider*> riders;
+    std::unordered_set<int> rideIDs; // Only filled once IDs arrive out of order
+    int lastRideID = std::numeric_limits<int>::min();
+    bool ridesInOrder = true;
+    std::unordered_map<std::string_view, KnownLocation> locations; // Views into data, valid during the import
+    LocationTable& table = LocationTable::shared();
+    auto location = [&](std::string_view name) {
+        auto it = locations.find(name);
+        if (it == locations.end()) {
+            LocationId id = table.intern(name);
+            it = locations.emplace(name, KnownLocation{id, table.zone(id)}).first;
+        }
+        return it->second;
+    };
+    // Dumps usually list rides by increasing ID, which needs one compare
+    // per ride; the first ID out of order switches to a set of every ID
+    auto firstRideWithID = [&](int id) {
+        if (ridesInOrder) {
+            if (id > lastRideID) {
+                lastRideID = id;
+                return true;
+            }
+            ridesInOrder = false;
+            rideIDs.reserve(result.rides.capacity());
+            for (RideHandle ride : result.rides) {
+                rideIDs.insert(store.getRide(ride).getRideID());
+            }
+        }
+        return rideIDs.insert(id).second;
+    };
+    auto number = [](std::string_view text, auto& value) {
+        auto parsed = std::from_chars(text.data(), text.data() + text.size(), value);
+        return parsed.ec == std::errc() && parsed.ptr == text.data() + text.size();
+    };
 
-protected:
-    double baseFareRate;
-public:
-    // Constructor
-    Ride(int id, const std::string& pickup, const std::string& dropoff, double dist)
-        : rideID(id), pickupLocation(pickup), dropoffLocation(dropoff), distance(dist), baseFareRate(2.0) {}
+    // Pre-size the columns from the line count (a memchr scan, far cheaper
+    // than growing nine columns one reallocation at a time)
+    size_t lines = 0;
+    for (const char* p = data.data(); (p = static_cast<const char*>(
+             std::memchr(p, '\n', static_cast<size_t>(data.data() + data.size() - p)))) != nullptr; ++p) {
+        ++lines;
+    }
+    store.reserve(store.size() + lines + 1);
+    result.rides.reserve(lines + 1);
 
-    // Virtual destructor for proper polymorphism
-    virtual ~Ride() = default;
-    // Virtual method for polymorphism - to be overridden by subclasses
-    virtual double fare() const {
-        return distance * baseFareRate;
+    forEachCsvRecord(data, [&](std::span<const std::string_view> fields) {
+        std::string_view kind = fields[0];
+        int id = 0;
+        if (fields.size() < 2 || !number(fields[1], id)) {
+            ++result.malformedRecords;
+            return;
+        }
+        if (kind == "ride" && fields.size() == 8) {
+            double distance = 0.0;
+            int driverID = 0;
+            int riderID = 0;
+            auto driver = drivers.end();
+            auto rider = riders.end();
+            bool premium = fields[2] == rideTypeName(RideType::Premium);
+            if ((premium || fields[2] == rideTypeName(RideType::Standard)) && number(fields[5], distance) &&
+                number(fields[6], driverID) && number(fields[7], riderID) &&
+                (driver = drivers.find(driverID)) != drivers.end() && (rider = riders.find(riderID)) != riders.end() &&
+                firstRideWithID(id)) {
+                KnownLocation pickup = location(fields[3]);
+                LocationId dropoff = location(fields[4]).id;
+                RideHandle ride = premium
+                    ? store.emplace<PremiumRide>(arena, id, pickup.id, dropoff, pickup.zone, distance)
+                    : store.emplace<StandardRide>(arena, id, pickup.id, dropoff, pickup.zone, distance);
+                driver->second->restoreRide(ride);
+                rider->second->restoreRide(ride);
+                result.rides.push_back(ride);
+                return;
+            }
+        } else if (kind == "driver" && fields.size() == 4) {
+            double rating = 0.0;
+            if (number(fields[3], rating) && !drivers.contains(id)) {
+                result.drivers.push_back(std::make_unique<Driver>(id, std::string(fields[2]), rating, store));
+                drivers.emplace(id, result.drivers.back().get());
+                return;
+            }
+        } else if (kind == "rider" && fields.size() == 3) {
+            if (!riders.contains(id)) {
+                result.riders.push_back(std::make_unique<Rider>(id, std::string(fields[2]), store));
+                riders.emplace(id, result.riders.back().get());
+                return;
+            }
+        }
+        ++result.malformedRecords;
+    });
+    // The loaded IDs are taken: later rides, drivers and riders get fresh ones
+    int maxRideID = 0;
+    for (RideHandle ride : result.rides) {
+        maxRideID = std::max(maxRideID, store.getRide(ride).getRideID());
     }
-    // Method to display ride details
-    virtual void rideDetails() const {
-        std::cout << "Ride ID: " << rideID << std::endl;
-        std::cout << "Pickup: " << pickupLocation << std::endl;
-        std::cout << "Dropoff: " << dropoffLocation << std::endl;
-        std::cout << "Distance: " << distance << " miles" << std::endl;
-        std::cout << "Fare: $" << std::fixed << std::setprecision(2) << fare() << std::endl;
+    rideIDSequence().advancePast(maxRideID);
+    for (const auto& driver : result.drivers) {
+        driver->publishSnapshot();
+        driverIDSequence().advancePast(driver->getDriverID());
+    }
+    for (const auto& rider : result.riders) {
+        rider->publishSnapshot();
+        riderIDSequence().advancePast(rider->getRiderID());
     }
+    return result;
+}
 
-    // Getter methods (encapsulation)
-    int getRideID() const { return rideID; }
-    std::string getPickupLocation() const { return pickupLocation; }
-    std::string getDropoffLocation() const { return dropoffLocation; }
-    double getDistance() const { return distance; }
+// Maps the file read-only (sequential access) and imports it
+RideImport importRideFile(const std::string& path, RideArena& arena, RideStore& store) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw std::system_error(errno, std::generic_category(), "importRideFile: cannot open " + path);
+    }
+    struct stat info {};
+    if (::fstat(fd, &info) != 0) {
+        int error = errno;
+        ::close(fd);
+        throw std::system_error(error, std::generic_category(), "importRideFile: cannot stat " + path);
+    }
+    size_t length = static_cast<size_t>(info.st_size);
+    if (length == 0) {
+        ::close(fd);
+        return RideImport{};
+    }
+    void* mapping = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    int error = errno;
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        throw std::system_error(error, std::generic_category(), "importRideFile: cannot map " + path);
+    }
+    ::madvise(mapping, length, MADV_SEQUENTIAL);
+    try {
+        RideImport result = importRideRecords({static_cast<const char*>(mapping), length}, arena, store);
+        ::munmap(mapping, length);
+        return result;
+    } catch (...) {
+        ::munmap(mapping, length);
+        throw;
+    }
+}
 
-    // Virtual method to get ride type (for polymorphism demonstration)
-    virtual std::string getRideType() const { return "Standard"; }
+// CRC-32 (IEEE 802.3) used to detect torn or corrupt log records
+constexpr std::array<std::uint32_t, 256> makeCrc32Table() {
+    std::array<std::uint32_t, 256> table{};
+    for (std::uint32_t i = 0; i < 256; ++i) {
+        std::uint32_t c = i;
+        for (int bit = 0; bit < 8; ++bit) {
+            c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        }
+        table[i] = c;
+    }
+    return table;
+}
+
+inline std::uint32_t crc32(std::string_view bytes) {
+    static constexpr std::array<std::uint32_t, 256> table = makeCrc32Table();
+    std::uint32_t c = 0xFFFFFFFFu;
+    for (char byte : bytes) {
+        c = table[(c ^ static_cast<std::uint8_t>(byte)) & 0xFF] ^ (c >> 8);
+    }
+    return c ^ 0xFFFFFFFFu;
+}
+
+// One logged event, as read back during recovery
+struct WalEvent {
+    enum class Kind : std::uint8_t { RideAssigned = 1, RideRequested = 2 };
+
+    Kind kind = Kind::RideAssigned;
+    int ownerID = 0; // Driver for RideAssigned, rider for RideRequested
+    int rideID = 0;
+    RideType type = RideType::Standard;
+    double distance = 0.0;
+    std::string_view pickup;  // Valid only during the replay callback
+    std::string_view dropoff;
+    double surgeMultiplier = 1.0; // As charged; 1.0 for records logged before it was
 };
 
-// StandardRide class - inheritance and polymorphism
-class StandardRide : public Ride {
+// WriteAheadLog - append-only durable log of ride assignment/request events
+// Record layout: [u32 payload length][u32 crc32 of payload][payload], where
+// the payload is kind, owner id, ride id, type, distance, the two
+// length-prefixed location names (names, not ids, so the log outlives the
+// process's LocationTable) and the ride's surge multiplier. Older records
+// end after the names and replay with no surge.
+// Appends only copy the encoded record into an in-memory batch. A
+// background thread writes the batch and fdatasync()s it once per
+// fsyncInterval, or as soon as maxBatchEvents are pending (group commit),
+// so no request pays for its own fsync. Callers that need an
+// acknowledgement wait on waitDurable(sequence). A failed write or fsync is
+// fatal: the flusher's exception terminates the process, because once an
+// fsync has failed durability can no longer be promised. Thread safe.
+struct WalOptions {
+    std::chrono::microseconds fsyncInterval{2000}; // Longest an event waits for its fsync
+    size_t maxBatchEvents = 256;                   // Commit early once this many are pending
+};
+
+class WriteAheadLog : public RideEventListener {
+private:
+    int fd = -1;
+    WalOptions options;
+    std::mutex mutex;
+    std::condition_variable flushWanted;
+    std::condition_variable durable;
+    std::string pending;               // Encoded records not yet written
+    size_t pendingEvents = 0;
+    std::uint64_t appendedSequence = 0;
+    std::uint64_t durableSequence = 0;
+    bool flushRequested = false;       // A waiter wants the batch now
+    bool stopping = false;
+    std::thread flusher;
+
+    template <typename T>
+    static void put(std::string& out, T value) {
+        out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    template <typename T>
+    static bool get(std::string_view& in, T& value) {
+        if (in.size() < sizeof(value)) {
+            return false;
+        }
+        std::memcpy(&value, in.data(), sizeof(value));
+        in.remove_prefix(sizeof(value));
+        return true;
+    }
+
+    static bool getName(std::string_view& in, std::string_view& name) {
+        std::uint16_t length = 0;
+        if (!get(in, length) || in.size() < length) {
+            return false;
+        }
+        name = in.substr(0, length);
+        in.remove_prefix(length);
+        return true;
+    }
+
+    static std::string_view clampName(std::string_view name) {
+        return name.substr(0, std::numeric_limits<std::uint16_t>::max());
+    }
+
+    void flushLoop() {
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;) {
+            flushWanted.wait_for(lock, options.fsyncInterval,
+                                 [this] { return stopping || flushRequested || pendingEvents >= options.maxBatchEvents; });
+            flushRequested = false;
+            if (pendingEvents == 0) {
+                if (stopping) {
+                    return;
+                }
+                continue;
+            }
+            std::string batch;
+            batch.swap(pending);
+            std::uint64_t batchSequence = appendedSequence;
+            pendingEvents = 0;
+
+            lock.unlock(); // Appends continue into the fresh buffer meanwhile
+            FdSink(fd).write(batch);
+            if (::fdatasync(fd) != 0) {
+                throw std::system_error(errno, std::generic_category(), "WriteAheadLog: fdatasync failed");
+            }
+            lock.lock();
+
+            durableSequence = batchSequence;
+            durable.notify_all();
+        }
+    }
+
+    // Length of the longest prefix of the file made of intact records
+    static size_t scan(const std::string& path, const std::function<void(const WalEvent&)>& visit) {
+        int in = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (in < 0) {
+            if (errno == ENOENT) {
+                return 0;
+            }
+            throw std::system_error(errno, std::generic_category(), "WriteAheadLog: cannot open " + path);
+        }
+        std::string contents;
+        char chunk[1 << 16];
+        for (;;) {
+            ssize_t n = ::read(in, chunk, sizeof(chunk));
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                break;
+            }
+            contents.append(chunk, static_cast<size_t>(n));
+        }
+        ::close(in);
+
+        std::string_view rest(contents);
+        size_t valid = 0;
+        for (;;) {
+            std::string_view header = rest;
+            std::uint32_t length = 0;
+            std::uint32_t checksum = 0;
+            if (!get(header, length) || !get(header, checksum) || header.size() < length) {
+                break; // Torn tail
+            }
+            std::string_view payload = header.substr(0, length);
+            if (crc32(payload) != checksum) {
+                break;
+            }
+            WalEvent event;
+            std::int32_t owner = 0;
+            std::int32_t ride = 0;
+            if (!get(payload, event.kind) || !get(payload, owner) || !get(payload, ride) ||
+                !get(payload, event.type) || !get(payload, event.distance) ||
+                !getName(payload, event.pickup) || !getName(payload, event.dropoff) ||
+                (!payload.empty() && !get(payload, event.surgeMultiplier))) {
+                break;
+            }
+            event.ownerID = owner;
+            event.rideID = ride;
+            if (visit) {
+                visit(event);
+            }
+            rest = header.substr(length);
+            valid = contents.size() - rest.size();
+        }
+        return valid;
+    }
+
 public:
-    StandardRide(int id, const std::string& pickup, const std::string& dropoff, double dist)
-        : Ride(id, pickup, dropoff, dist) {
-        baseFareRate = 2.0;
+    // Opens (or creates) the log for appending. A torn record left at the
+    // end by a crash is truncated away first.
+    explicit WriteAheadLog(const std::string& path, WalOptions logOptions = {}) : options(logOptions) {
+        size_t valid = scan(path, nullptr);
+        fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            throw std::system_error(errno, std::generic_category(), "WriteAheadLog: cannot open " + path);
+        }
+        if (::ftruncate(fd, static_cast<off_t>(valid)) != 0 || ::lseek(fd, 0, SEEK_END) < 0) {
+            int error = errno;
+            ::close(fd);
+            throw std::system_error(error, std::generic_category(), "WriteAheadLog: cannot position " + path);
+        }
+        flusher = std::thread([this] { flushLoop(); });
     }
 
-    // Override fare method (polymorphism)
-    double fare() const override {
-        return getDistance() * baseFareRate;
+    // Flushes everything appended so far before closing
+    ~WriteAheadLog() override {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        flushWanted.notify_one();
+        flusher.join();
+        ::close(fd);
+    }
+
+    WriteAheadLog(const WriteAheadLog&) = delete;
+    WriteAheadLog& operator=(const WriteAheadLog&) = delete;
+
+    // Queues an event for the next group commit; returns its sequence number
+    std::uint64_t append(WalEvent::Kind kind, int ownerID, const Ride& ride) {
+        std::string_view pickup = clampName(ride.getPickupLocation());
+        std::string_view dropoff = clampName(ride.getDropoffLocation());
+        std::string payload;
+        payload.reserve(40 + pickup.size() + dropoff.size());
+        put(payload, kind);
+        put(payload, static_cast<std::int32_t>(ownerID));
+        put(payload, static_cast<std::int32_t>(ride.getRideID()));
+        put(payload, ride.getTypeTag());
+        put(payload, ride.getDistance());
+        put(payload, static_cast<std::uint16_t>(pickup.size()));
+        payload.append(pickup);
+        put(payload, static_cast<std::uint16_t>(dropoff.size()));
+        payload.append(dropoff);
+        put(payload, ride.getSurgeMultiplier());
+
+        std::uint64_t sequence;
+        bool batchFull;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            put(pending, static_cast<std::uint32_t>(payload.size()));
+            put(pending, crc32(payload));
+            pending.append(payload);
+            sequence = ++appendedSequence;
+            batchFull = ++pendingEvents >= options.maxBatchEvents;
+        }
+        if (batchFull) {
+            flushWanted.notify_one();
+        }
+        return sequence;
+    }
+
+    // Blocks until the event with this sequence number is on stable storage
+    void waitDurable(std::uint64_t sequence) {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (durableSequence >= sequence) {
+            return;
+        }
+        flushRequested = true;
+        flushWanted.notify_one();
+        durable.wait(lock, [&] { return durableSequence >= sequence; });
     }
 
-    std::string getRideType() const override {
-        return "Standard";
+    void onRideAssigned(const Driver& driver, const Ride& ride) override;
+    void onRideRequested(const Rider& rider, const Ride& ride) override;
+
+    // Calls visit for every intact event in the log, in append order.
+    // Returns the number of events replayed.
+    static size_t replay(const std::string& path, const std::function<void(const WalEvent&)>& visit) {
+        size_t events = 0;
+        scan(path, [&](const WalEvent& event) {
+            ++events;
+            visit(event);
+        });
+        return events;
     }
 };
 
-// PremiumRide class - inheritance and polymorphism
-class PremiumRide : public Ride {
+void WriteAheadLog::onRideAssigned(const Driver& driver, const Ride& ride) {
+    append(WalEvent::Kind::RideAssigned, driver.getDriverID(), ride);
+}
+
+void WriteAheadLog::onRideRequested(const Rider& rider, const Ride& ride) {
+    append(WalEvent::Kind::RideRequested, rider.getRiderID(), ride);
+}
+
+// Rebuilds Driver/Rider ride state from a write-ahead log. Rides are
+// recreated in rides (from arena) once per ride ID and restored onto the
+// listed drivers and riders without re-logging. A ride has one driver and
+// one rider, so repeated events for a ride are ignored, and events for
+// unknown drivers or riders are skipped. Returns the number of events replayed.
+size_t recoverFromLog(const std::string& path, RideArena& arena, RideStore& rides,
+                      const std::unordered_map<int, Driver*>& drivers,
+                      const std::unordered_map<int, Rider*>& riders) {
+    struct Recovered {
+        RideHandle handle;
+        bool assigned = false;
+        bool requested = false;
+    };
+    std::unordered_map<int, Recovered> recovered;
+    size_t events = WriteAheadLog::replay(path, [&](const WalEvent& event) {
+        auto [it, inserted] = recovered.try_emplace(event.rideID);
+        Recovered& ride = it->second;
+        if (inserted) {
+            RidePtr created = event.type == RideType::Premium
+                ? arena.make<PremiumRide>(event.rideID, event.pickup, event.dropoff, event.distance)
+                : arena.make<StandardRide>(event.rideID, event.pickup, event.dropoff, event.distance);
+            created->setSurgeMultiplier(event.surgeMultiplier); // Charged then, not now
+            ride.handle = rides.add(std::move(created));
+        }
+        if (event.kind == WalEvent::Kind::RideAssigned) {
+            auto driver = drivers.find(event.ownerID);
+            if (!ride.assigned && driver != drivers.end()) {
+                driver->second->restoreRide(ride.handle);
+                ride.assigned = true;
+            }
+        } else {
+            auto rider = riders.find(event.ownerID);
+            if (!ride.requested && rider != riders.end()) {
+                rider->second->restoreRide(ride.handle);
+                ride.requested = true;
+            }
+        }
+    });
+    // Recovered IDs are taken: new rides, drivers and riders get fresh ones
+    int lastRideID = 0;
+    for (const auto& [id, ride] : recovered) {
+        lastRideID = std::max(lastRideID, id);
+    }
+    rideIDSequence().advancePast(lastRideID);
+    for (const auto& [id, driver] : drivers) {
+        driver->publishSnapshot();
+        driverIDSequence().advancePast(id);
+    }
+    for (const auto& [id, rider] : riders) {
+        rider->publishSnapshot();
+        riderIDSequence().advancePast(id);
+    }
+    return events;
+}
+
+// BoundedQueue - blocking FIFO with a fixed capacity, used between
+// pipeline stages so a slow stage applies backpressure instead of letting
+// memory grow. close() wakes everyone; pop() then drains what is left and
+// returns nullopt.
+template <typename T>
+class BoundedQueue {
 private:
-    double luxuryMultiplier;
+    std::deque<T> items;
+    size_t capacity;
+    bool closed = false;
+    std::mutex mutex;
+    std::condition_variable notEmpty;
+    std::condition_variable notFull;
 
 public:
-    PremiumRide(int id, const std::string& pickup, const std::string& dropoff, double dist)
-        : Ride(id, pickup, dropoff, dist), luxuryMultiplier(1.8) {
-        baseFareRate = 3.5;
+    explicit BoundedQueue(size_t maxItems) : capacity(maxItems == 0 ? 1 : maxItems) {}
+
+    // Returns false if the queue was closed
+    bool push(T item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        notFull.wait(lock, [this] { return closed || items.size() < capacity; });
+        if (closed) {
+            return false;
+        }
+        items.push_back(std::move(item));
+        notEmpty.notify_one();
+        return true;
     }
 
-    // Override fare method with premium pricing (polymorphism)
-    double fare() const override {
-        return getDistance() * baseFareRate * luxuryMultiplier;
+    std::optional<T> pop() {
+        std::unique_lock<std::mutex> lock(mutex);
+        notEmpty.wait(lock, [this] { return closed || !items.empty(); });
+        if (items.empty()) {
+            return std::nullopt;
+        }
+        T item = std::move(items.front());
+        items.pop_front();
+        notFull.notify_one();
+        return item;
     }
 
-    std::string getRideType() const override {
-        return "Premium";
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        notEmpty.notify_all();
+        notFull.notify_all();
     }
+};
+
+// A ride event after each pipeline stage
+struct ParsedRideEvent {
+    std::int64_t timestamp = 0; // Seconds
+    int rideID = 0;
+    int driverID = 0;
+    RideType type = RideType::Standard;
+    double distance = 0.0;
+    ZoneId pickupZone = 0; // Zone of the pickup location, 0 when none is given
+};
+
+struct PricedRideEvent {
+    std::int64_t timestamp = 0;
+    int driverID = 0;
+    RideType type = RideType::Standard;
+    Money fare;
+};
 
-    void rideDetails() const override {
-        std::cout << "=== PREMIUM RIDE ===" << std::endl;
-        Ride::rideDetails();
-        std::cout << "Luxury Multiplier: " << luxuryMultiplier << "x" << std::endl;
+// Parses "timestamp,rideID,driverID,type,distance[,pickup]" (type is
+// Standard or Premium; pickup is a location name, whose surge zone the
+// ride is priced in). Returns nullopt for malformed lines.
+std::optional<ParsedRideEvent> parseRideEvent(std::string_view line) {
+    std::array<std::string_view, 6> fields;
+    size_t fieldCount = 0;
+    while (fieldCount < fields.size()) {
+        size_t comma = line.find(',');
+        fields[fieldCount++] = line.substr(0, comma);
+        if (comma == std::string_view::npos) {
+            break;
+        }
+        line.remove_prefix(comma + 1);
+        if (fieldCount == fields.size()) {
+            return std::nullopt; // Too many fields
+        }
+    }
+    if (fieldCount < 5) {
+        return std::nullopt;
+    }
+    auto number = [](std::string_view text, auto& value) {
+        auto result = std::from_chars(text.data(), text.data() + text.size(), value);
+        return result.ec == std::errc() && result.ptr == text.data() + text.size();
+    };
+    ParsedRideEvent event;
+    if (!number(fields[0], event.timestamp) || !number(fields[1], event.rideID) ||
+        !number(fields[2], event.driverID) || !number(fields[4], event.distance)) {
+        return std::nullopt;
     }
+    if (fields[3] == rideTypeName(RideType::Premium)) {
+        event.type = RideType::Premium;
+    } else if (fields[3] != rideTypeName(RideType::Standard)) {
+        return std::nullopt;
+    }
+    if (fieldCount == 6) {
+        if (fields[5].empty()) {
+            return std::nullopt;
+        }
+        LocationTable& locations = LocationTable::shared();
+        event.pickupZone = locations.zone(locations.intern(fields[5]));
+    }
+    return event;
+}
+
+// Fare totals for one window
+struct WindowTotals {
+    std::int64_t start = 0; // Inclusive, seconds
+    std::int64_t end = 0;   // Exclusive
+    std::array<Money, rideTypeCount> amountByType{};
+    std::array<size_t, rideTypeCount> ridesByType{};
+    std::unordered_map<int, Money> earningsByDriver;
 };
 
-// Driver class demonstrating encapsulation
-class Driver {
+// WindowAggregator - tumbling or sliding event-time windows over priced
+// rides. Events are bucketed into panes one slide long; a window is the sum
+// of the windowLength / slide most recent panes, and is emitted once an
+// event at or past its end arrives (or on finish()). Only the panes of the
+// open windows are kept, so memory is bounded by the window length, not by
+// the stream. Events must arrive in timestamp order; events older than
+// every retained pane are counted as late and dropped.
+class WindowAggregator {
 private:
-    int driverID;
-    std::string name;
-    double rating;
-    std::vector<std::shared_ptr<Ride>> assignedRides; // Encapsulated - private member
+    struct Pane {
+        std::int64_t start = 0;
+        std::array<Money, rideTypeCount> amountByType{};
+        std::array<size_t, rideTypeCount> ridesByType{};
+        std::unordered_map<int, Money> earningsByDriver;
+    };
+
+    std::int64_t windowLength;
+    std::int64_t slide;
+    std::function<void(const WindowTotals&)> emit;
+    std::deque<Pane> panes;          // Ascending, contiguous pane starts
+    std::int64_t nextWindowEnd = 0;  // End of the oldest window not yet emitted
+    bool started = false;
+    size_t lateEvents = 0;
+
+    std::int64_t paneStart(std::int64_t timestamp) const {
+        std::int64_t q = timestamp / slide;
+        if (timestamp % slide != 0 && timestamp < 0) {
+            --q;
+        }
+        return q * slide;
+    }
+
+    void emitWindow(std::int64_t end) {
+        WindowTotals window;
+        window.start = end - windowLength;
+        window.end = end;
+        for (const Pane& pane : panes) {
+            if (pane.start < window.start || pane.start >= end) {
+                continue;
+            }
+            for (size_t t = 0; t < rideTypeCount; ++t) {
+                window.amountByType[t] += pane.amountByType[t];
+                window.ridesByType[t] += pane.ridesByType[t];
+            }
+            for (const auto& [driverID, amount] : pane.earningsByDriver) {
+                window.earningsByDriver[driverID] += amount;
+            }
+        }
+        emit(window);
+        // Panes before the next window's start are no longer needed
+        while (!panes.empty() && panes.front().start < end + slide - windowLength) {
+            panes.pop_front();
+        }
+    }
 
 public:
-    Driver(int id, const std::string& driverName, double driverRating)
-        : driverID(id), name(driverName), rating(driverRating) {}
+    WindowAggregator(std::int64_t windowSeconds, std::int64_t slideSeconds,
+                     std::function<void(const WindowTotals&)> onWindow)
+        : windowLength(windowSeconds), slide(slideSeconds), emit(std::move(onWindow)) {
+        if (slideSeconds <= 0 || windowSeconds <= 0 || windowSeconds % slideSeconds != 0) {
+            throw std::invalid_argument("WindowAggregator: window must be a positive multiple of the slide");
+        }
+    }
 
-    // Method to add ride (controlled access to private member)
-    void addRide(std::shared_ptr<Ride> ride) {
-        assignedRides.push_back(ride);
+    void add(const PricedRideEvent& event) {
+        std::int64_t start = paneStart(event.timestamp);
+        if (!started) {
+            started = true;
+            nextWindowEnd = start + slide;
+        }
+        // Close every window that ends at or before this event
+        while (nextWindowEnd <= event.timestamp) {
+            if (panes.empty()) {
+                nextWindowEnd = start + slide; // Skip over windows with no events
+                break;
+            }
+            emitWindow(nextWindowEnd);
+            nextWindowEnd += slide;
+        }
+        if (start < nextWindowEnd - windowLength) {
+            ++lateEvents;
+            return;
+        }
+        if (panes.empty() || panes.back().start < start) {
+            panes.emplace_back().start = start;
+        }
+        auto pane = std::find_if(panes.begin(), panes.end(), [&](const Pane& p) { return p.start == start; });
+        if (pane == panes.end()) {
+            ++lateEvents; // Out of order within the open windows
+            return;
+        }
+        size_t type = static_cast<size_t>(event.type);
+        pane->amountByType[type] += event.fare;
+        ++pane->ridesByType[type];
+        pane->earningsByDriver[event.driverID] += event.fare;
     }
 
-    // Method to display driver info
-    void getDriverInfo() const {
-        std::cout << "\n=== DRIVER INFORMATION ===" << std::endl;
-        std::cout << "Driver ID: " << driverID << std::endl;
-        std::cout << "Name: " << name << std::endl;
-        std::cout << "Rating: " << rating << "/5.0" << std::endl;
-        std::cout << "Total Rides Completed: " << assignedRides.size() << std::endl;
-        
-        double totalEarnings = 0.0;
-        for (const auto& ride : assignedRides) {
-            totalEarnings += ride->fare();
+    // Emits every window that still contains events
+    void finish() {
+        while (!panes.empty()) {
+            emitWindow(nextWindowEnd);
+            nextWindowEnd += slide;
         }
-        std::cout << "Total Earnings: $" << std::fixed << std::setprecision(2) << totalEarnings << std::endl;
     }
 
-    // Getter methods (controlled access)
-    int getDriverID() const { return driverID; }
-    std::string getName() const { return name; }
-    double getRating() const { return rating; }
-    size_t getRideCount() const { return assignedRides.size(); }
+    size_t getLateEvents() const { return lateEvents; }
 };
 
-// Rider class demonstrating encapsulation
-class Rider {
+// RideEventPipeline - parse -> price -> aggregate, one thread per stage,
+// connected by bounded queues. Reads ride events from a text stream and
+// calls onWindow (from the aggregate thread) for every closed window.
+// The price stage quotes each event against the surge table current when
+// it is priced, as a Ride created at that moment would be.
+class RideEventPipeline {
 private:
-    int riderID;
-    std::string name;
-    std::vector<std::shared_ptr<Ride>> requestedRides; // Encapsulated - private member
+    size_t queueCapacity;
+    std::int64_t windowSeconds;
+    std::int64_t slideSeconds;
+    size_t malformedLines = 0;
+    size_t lateEvents = 0;
 
 public:
-    Rider(int id, const std::string& riderName)
-        : riderID(id), name(riderName) {}
+    RideEventPipeline(std::int64_t window, std::int64_t slide, size_t capacity = 4096)
+        : queueCapacity(capacity), windowSeconds(window), slideSeconds(slide) {}
 
-    // Method to request a ride (controlled access to private member)
-    void requestRide(std::shared_ptr<Ride> ride) {
-        requestedRides.push_back(ride);
-        std::cout << "Ride requested by " << name << " (ID: " << riderID << ")" << std::endl;
-    }
+    void run(std::istream& input, std::function<void(const WindowTotals&)> onWindow) {
+        BoundedQueue<ParsedRideEvent> parsed(queueCapacity);
+        BoundedQueue<PricedRideEvent> priced(queueCapacity);
+        WindowAggregator aggregator(windowSeconds, slideSeconds, std::move(onWindow));
 
-    // Method to view ride history
-    void viewRides() const {
-        std::cout << "\n=== RIDER RIDE HISTORY ===" << std::endl;
-        std::cout << "Rider: " << name << " (ID: " << riderID << ")" << std::endl;
-        std::cout << "Total Rides: " << requestedRides.size() << std::endl;
-        
-        double totalSpent = 0.0;
-        for (size_t i = 0; i < requestedRides.size(); ++i) {
-            std::cout << "\n--- Ride " << (i + 1) << " ---" << std::endl;
-            requestedRides[i]->rideDetails();
-            totalSpent += requestedRides[i]->fare();
+        std::thread price([&] {
+            while (auto event = parsed.pop()) {
+                FarePolicy policy = farePolicyFor(event->type);
+                double surge;
+                {
+                    EpochGuard guard; // Not held across pop(), which may block
+                    surge = SurgePricing::shared().current(guard).multiplier(event->pickupZone, 0);
+                }
+                priced.push(PricedRideEvent{event->timestamp, event->driverID, event->type,
+                                            Money::fromDollars(event->distance * policy.baseFareRate *
+                                                               policy.luxuryMultiplier * surge)});
+            }
+            priced.close();
+        });
+        std::thread aggregate([&] {
+            while (auto event = priced.pop()) {
+                aggregator.add(*event);
+            }
+            aggregator.finish();
+        });
+
+        // Parse stage runs on the calling thread
+        malformedLines = 0;
+        std::string line;
+        while (std::getline(input, line)) {
+            if (line.empty()) {
+                continue;
+            }
+            if (auto event = parseRideEvent(line)) {
+                parsed.push(*event);
+            } else {
+                ++malformedLines;
+            }
         }
-        std::cout << "\nTotal Amount Spent: $" << std::fixed << std::setprecision(2) << totalSpent << std::endl;
+        parsed.close();
+        price.join();
+        aggregate.join();
+        lateEvents = aggregator.getLateEvents();
     }
 
-    // Getter methods (controlled access)
-    int getRiderID() const { return riderID; }
-    std::string getName() const { return name; }
-    size_t getRideCount() const { return requestedRides.size(); }
+    size_t getMalformedLines() const { return malformedLines; }
+    size_t getLateEvents() const { return lateEvents; }
 };
 
+// Reads ride events from stdin and prints window totals. Run with
+// --stream [--window SECONDS] [--slide SECONDS].
+void runStreamingTotals(std::int64_t windowSeconds, std::int64_t slideSeconds) {
+    RideEventPipeline pipeline(windowSeconds, slideSeconds);
+    ReportWriter out;
+    pipeline.run(std::cin, [&](const WindowTotals& window) {
+        out << "Window [" << window.start << ", " << window.end << "):";
+        for (size_t t = 0; t < rideTypeCount; ++t) {
+            out << ' ' << rideTypeName(static_cast<RideType>(t)) << ' ' << window.ridesByType[t] << " rides $"
+                << window.amountByType[t];
+            out << (t + 1 < rideTypeCount ? ',' : ';');
+        }
+        std::vector<std::pair<int, Money>> drivers(window.earningsByDriver.begin(), window.earningsByDriver.end());
+        std::sort(drivers.begin(), drivers.end());
+        for (const auto& [driverID, amount] : drivers) {
+            out << " driver " << driverID << " $" << amount;
+        }
+        out << '\n';
+        out.flushTo(consoleSink());
+    });
+    std::cout << "Malformed lines: " << pipeline.getMalformedLines()
+              << ", late events: " << pipeline.getLateEvents() << std::endl;
+}
+
+// Throughput benchmark: equal numbers of producer and worker threads,
+// scaling from 1 to 32. Run with --bench-dispatch.
+void benchmarkDispatcher(size_t totalRequests = 1000000, int driverCount = 1024) {
+    std::cout << "\n=== DISPATCHER THROUGHPUT BENCHMARK ===" << std::endl;
+    std::cout << "Requests: " << totalRequests << ", drivers: " << driverCount
+              << ", hardware threads: " << std::thread::hardware_concurrency() << std::endl;
+    LocationId downtown = LocationTable::shared().intern("Downtown");
+    LocationId airport = LocationTable::shared().intern("Airport");
+
+    for (size_t threads = 1; threads <= 32; threads *= 2) {
+        RideDispatcher dispatcher(threads);
+        for (int d = 0; d < driverCount; ++d) {
+            dispatcher.addDriver(1000 + d, "Driver " + std::to_string(d), 4.5);
+        }
+        dispatcher.start();
+
+        auto begin = std::chrono::steady_clock::now();
+        std::vector<std::thread> producers;
+        size_t perProducer = totalRequests / threads;
+        for (size_t p = 0; p < threads; ++p) {
+            producers.emplace_back([&, p] {
+                for (size_t i = 0; i < perProducer; ++i) {
+                    RideRequest request;
+                    request.rideID = static_cast<int>(p * perProducer + i);
+                    request.driverID = 1000 + static_cast<int>((p * 7919 + i) % static_cast<size_t>(driverCount));
+                    request.type = (i & 1) ? RideType::Premium : RideType::Standard;
+                    request.pickup = downtown;
+                    request.dropoff = airport;
+                    request.distance = 1.0 + static_cast<double>(i % 30);
+                    dispatcher.submit(request);
+                }
+            });
+        }
+        for (auto& producer : producers) {
+            producer.join();
+        }
+        dispatcher.stop();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+
+        std::cout << std::setw(2) << threads << " producers x " << std::setw(2) << threads << " workers: "
+                  << std::fixed << std::setprecision(0) << (dispatcher.getAssignedCount() / elapsed.count())
+                  << " rides/s" << std::endl;
+    }
+}
+
+// Latency of ride requests all in flight at once: coroutines on one event
+// loop thread vs. one blocking thread per request (the same steps under a
+// lock). Latency runs from submission, so it includes thread start-up.
+// Requests name their driver, so the numbers measure scheduling rather
+// than matching. Run with --bench-async [MAX].
+void benchmarkAsyncRequests(size_t maxRequests = 10000) {
+    using Clock = std::chrono::steady_clock;
+    AsyncRideOptions options;
+    std::cout << "\n=== ASYNC REQUEST LATENCY BENCHMARK ===" << std::endl;
+    std::cout << "Simulated I/O per request: "
+              << std::chrono::duration<double, std::milli>(options.pricingLatency + options.matchingLatency +
+                                                           options.persistLatency).count()
+              << " ms in 3 round trips" << std::endl;
+    std::cout << std::left << std::setw(20) << "path" << std::right << std::setw(10) << "requests" << std::setw(12)
+              << "wall ms" << std::setw(10) << "p50 ms" << std::setw(10) << "p99 ms" << std::setw(10) << "max ms"
+              << std::endl;
+    LocationId downtown = LocationTable::shared().intern("Downtown");
+    LocationId airport = LocationTable::shared().intern("Airport");
+
+    for (size_t count = 100; count <= maxRequests; count *= 10) {
+        auto requestFor = [&](size_t i) {
+            RideRequest request;
+            request.rideID = static_cast<int>(i);
+            request.driverID = 1000 + static_cast<int>(i);
+            request.type = (i & 1) ? RideType::Premium : RideType::Standard;
+            request.pickup = downtown;
+            request.dropoff = airport;
+            request.distance = 1.0 + static_cast<double>(i % 30);
+            return request;
+        };
+        auto report = [&](std::string_view path, std::vector<double>& latencies, double wallMs) {
+            std::sort(latencies.begin(), latencies.end());
+            std::cout << std::left << std::setw(20) << path << std::right << std::setw(10) << latencies.size()
+                      << std::fixed << std::setprecision(2) << std::setw(12) << wallMs << std::setw(10)
+                      << latencies[latencies.size() / 2] << std::setw(10) << latencies[latencies.size() * 99 / 100]
+                      << std::setw(10) << latencies.back() << std::defaultfloat << std::endl;
+        };
+
+        for (int path = 0; path < 2; ++path) {
+            RideArena arena;
+            RideStore store;
+            DriverLocator locator;
+            std::vector<std::unique_ptr<Driver>> drivers;
+            Rider rider(1, "Bench Rider", store);
+            EventLoop loop;
+            AsyncRideDispatcher dispatcher(loop, store, arena, locator, options);
+            for (size_t i = 0; i < count; ++i) {
+                drivers.push_back(std::make_unique<Driver>(1000 + static_cast<int>(i), "Driver", 4.5, store));
+                locator.updatePosition(drivers.back()->getDriverID(), {static_cast<double>(i % 100), 0.0});
+                dispatcher.addDriver(*drivers.back());
+            }
+            std::vector<double> latencies(count);
+            auto begin = Clock::now();
+
+            if (path == 0) {
+                auto one = [&](size_t i, Clock::time_point submitted) -> Task<void> {
+                    co_await dispatcher.request(rider, requestFor(i));
+                    latencies[i] = std::chrono::duration<double, std::milli>(Clock::now() - submitted).count();
+                };
+                for (size_t i = 0; i < count; ++i) {
+                    loop.spawn(one(i, Clock::now()));
+                }
+                loop.run();
+                report("coroutine (1 thr)", latencies,
+                       std::chrono::duration<double, std::milli>(Clock::now() - begin).count());
+            } else {
+                std::mutex stateLock;
+                std::vector<std::thread> threads;
+                threads.reserve(count);
+                try {
+                    for (size_t i = 0; i < count; ++i) {
+                        threads.emplace_back([&, i, submitted = Clock::now()] {
+                            RideRequest request = requestFor(i);
+                            std::this_thread::sleep_for(options.pricingLatency);
+                            std::unique_lock<std::mutex> lock(stateLock);
+                            AsyncRideResult result = dispatcher.price(request);
+                            lock.unlock();
+                            std::this_thread::sleep_for(options.matchingLatency);
+                            lock.lock();
+                            dispatcher.match(request, result);
+                            lock.unlock();
+                            std::this_thread::sleep_for(options.persistLatency);
+                            lock.lock();
+                            dispatcher.commit(rider, result);
+                            lock.unlock();
+                            latencies[i] = std::chrono::duration<double, std::milli>(Clock::now() - submitted).count();
+                        });
+                    }
+                } catch (const std::system_error& error) {
+                    std::cout << std::left << std::setw(20) << "thread-per-request" << std::right << std::setw(10)
+                              << count << "  stopped after " << threads.size() << " threads: " << error.what()
+                              << std::endl;
+                }
+                for (std::thread& thread : threads) {
+                    thread.join();
+                }
+                if (threads.size() == count) {
+                    report("thread-per-request", latencies,
+                           std::chrono::duration<double, std::milli>(Clock::now() - begin).count());
+                }
+            }
+        }
+    }
+}
+
+#if defined(RIDE_ALLOCATION_TRACKING)
+// Heap allocations per ride request on the synchronous path (create the
+// ride, assign it, record it with the rider) and the coroutine path, then
+// what is still live once everything is torn down. Run with
+// --alloc-profile [N] in a build linked with AllocationTracker.cpp.
+void profileAllocations(size_t requests = 10000) {
+    std::cout << "\n=== ALLOCATION PROFILE ===" << std::endl;
+    std::cout << "Requests per path: " << requests << std::endl;
+    LocationId downtown = LocationTable::shared().intern("Downtown");
+    LocationId airport = LocationTable::shared().intern("Airport");
+    auto perRequest = [&](std::string_view path, const AllocationStats& before) {
+        AllocationStats after = AllocationTracker::stats();
+        double count = static_cast<double>(requests);
+        std::cout << path << ": " << std::fixed << std::setprecision(2)
+                  << static_cast<double>(after.allocations - before.allocations) / count << " allocations, "
+                  << static_cast<double>(after.bytesAllocated - before.bytesAllocated) / count
+                  << " bytes per request" << std::defaultfloat << std::endl;
+    };
+
+    AllocationStats baseline = AllocationTracker::stats();
+    {
+        RideArena arena;
+        RideStore store;
+        Driver driver(nextDriverID(), "Profile Driver", 4.5, store);
+        Rider rider(nextRiderID(), "Profile Rider", store);
+        AllocationStats before = AllocationTracker::stats();
+        for (size_t i = 0; i < requests; ++i) {
+            RideHandle ride = store.emplace<StandardRide>(arena, nextRideID(), downtown, airport, 10.0);
+            driver.addRide(ride);
+            rider.addRide(ride);
+        }
+        perRequest("Synchronous request", before);
+    }
+    {
+        RideArena arena;
+        RideStore store;
+        DriverLocator locator;
+        std::vector<std::unique_ptr<Driver>> drivers;
+        Rider rider(nextRiderID(), "Profile Rider", store);
+        EventLoop loop;
+        AsyncRideDispatcher dispatcher(loop, store, arena, locator);
+        for (size_t i = 0; i < requests; ++i) {
+            drivers.push_back(std::make_unique<Driver>(nextDriverID(), "Profile Driver", 4.5, store));
+            locator.updatePosition(drivers.back()->getDriverID(), {static_cast<double>(i % 100), 0.0});
+            dispatcher.addDriver(*drivers.back());
+        }
+        AllocationStats before = AllocationTracker::stats();
+        auto one = [&](RideRequest request) -> Task<void> { co_await dispatcher.request(rider, request); };
+        for (size_t i = 0; i < requests; ++i) {
+            RideRequest request;
+            request.rideID = nextRideID();
+            request.driverID = drivers[i]->getDriverID();
+            request.pickup = downtown;
+            request.dropoff = airport;
+            request.distance = 10.0;
+            loop.spawn(one(request));
+        }
+        loop.run();
+        perRequest("Coroutine request", before);
+    }
+    AllocationStats after = AllocationTracker::stats();
+    std::cout << "Still live after teardown: " << after.liveAllocations - baseline.liveAllocations
+              << " allocations, " << static_cast<std::int64_t>(after.liveBytes - baseline.liveBytes) << " bytes"
+              << std::endl;
+    AllocationTracker::report(std::cout, 8);
+}
+#endif
+
+// Keeps a benchmark result alive without the compiler discarding the work
+template <typename T>
+inline void doNotOptimize(const T& value) {
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    static volatile const void* sink;
+    sink = &value;
+#endif
+}
+
+// Times body, repeating it until the minimum measuring time is reached,
+// and prints the time per ride (or per call when perCall is set, for
+// operations whose cost does not scale with the ride count).
+// This is a small in-file stand-in for Google Benchmark or nanobench,
+// which the single-file build cannot pull in: like them it warms up,
+// doubles the batch until the run is long enough to swamp clock overhead,
+// and keeps results alive with doNotOptimize(), but it reports one mean
+// per case rather than error bars.
+template <typename Body>
+void runBenchmark(std::string_view name, size_t rides, Body&& body, bool perCall = false) {
+    using Clock = std::chrono::steady_clock;
+    constexpr std::chrono::milliseconds minTime{200};
+    body(); // Warm-up: faults in pages and fills caches
+    // The clock is read once per batch, and the batch doubles, so cheap
+    // bodies are not dominated by timer overhead
+    size_t iterations = 0;
+    auto begin = Clock::now();
+    Clock::duration elapsed{};
+    for (size_t batch = 1; elapsed < minTime; batch *= 2) {
+        for (size_t i = 0; i < batch; ++i) {
+            body();
+        }
+        iterations += batch;
+        elapsed = Clock::now() - begin;
+    }
+    size_t items = iterations * (perCall ? 1 : rides);
+    double nsPerItem = std::chrono::duration<double, std::nano>(elapsed).count() / static_cast<double>(items);
+    std::cout << std::left << std::setw(28) << name << std::right << std::setw(10) << rides
+              << std::setw(12) << std::fixed << std::setprecision(2) << nsPerItem
+              << (perCall ? " ns/call" : " ns/ride") << std::endl;
+}
+
+// Hot-path micro-benchmarks, parameterized by ride count (1k, 10k, ... up
+// to 10M by default; the 10M cases need a few GB of memory, mostly for the
+// bulk_import CSV). Rides alternate type in blocks of 64, a realistic mix
+// for the batch kernel.
+void runBenchmarks(size_t maxRides = 10000000) {
+    std::cout << "\n=== RIDE SHARING MICRO-BENCHMARKS ===" << std::endl;
+    std::cout << std::left << std::setw(28) << "benchmark" << std::right << std::setw(10) << "rides"
+              << std::setw(20) << "time" << std::endl;
+    LocationId downtown = LocationTable::shared().intern("Downtown");
+    LocationId airport = LocationTable::shared().intern("Airport");
+    auto typeOf = [](size_t i) { return (i / 64) & 1 ? RideType::Premium : RideType::Standard; };
+    auto distanceOf = [](size_t i) { return 1.0 + static_cast<double>(i % 30); };
+
+    for (size_t rides = 1000; rides <= maxRides; rides *= 10) {
+        runBenchmark("ride_construction", rides, [&] {
+            RideArena arena;
+            std::vector<RidePtr> made;
+            made.reserve(rides);
+            for (size_t i = 0; i < rides; ++i) {
+                int id = static_cast<int>(i);
+                if (typeOf(i) == RideType::Premium) {
+                    made.push_back(arena.make<PremiumRide>(id, downtown, airport, distanceOf(i)));
+                } else {
+                    made.push_back(arena.make<StandardRide>(id, downtown, airport, distanceOf(i)));
+                }
+            }
+            doNotOptimize(made.data());
+        });
+
+        RideArena arena;
+        RideStore store;
+        std::vector<RideHandle> handles;
+        handles.reserve(rides);
+        for (size_t i = 0; i < rides; ++i) {
+            int id = static_cast<int>(i);
+            handles.push_back(typeOf(i) == RideType::Premium
+                                  ? store.emplace<PremiumRide>(arena, id, downtown, airport, distanceOf(i))
+                                  : store.emplace<StandardRide>(arena, id, downtown, airport, distanceOf(i)));
+        }
+
+        runBenchmark("fare_virtual", rides, [&] {
+            double total = 0.0;
+            for (RideHandle handle : handles) {
+                total += store.getRide(handle).fare();
+            }
+            doNotOptimize(total);
+        });
+
+        std::vector<double> fares(rides);
+        runBenchmark("fare_batch_kernel", rides, [&] {
+            store.computeFares(fares);
+            doNotOptimize(fares.data());
+        });
+
+        runBenchmark("driver_add_ride", rides, [&] {
+            Driver driver(1, "Bench Driver", 4.5, store);
+            for (RideHandle handle : handles) {
+                driver.addRide(handle);
+            }
+            driver.publishSnapshot();
+            doNotOptimize(driver.getTotalEarnings());
+        });
+        // Ingestion with publication on: a snapshot per ride, as if every
+        // ride were its own batch
+        runBenchmark("driver_add_ride_published", rides, [&] {
+            Driver driver(1, "Bench Driver", 4.5, store);
+            for (RideHandle handle : handles) {
+                driver.addRide(handle);
+                driver.publishSnapshot();
+            }
+            doNotOptimize(driver.getTotalEarnings());
+        });
+        runBenchmark("driver_add_ride_spilled", rides, [&] {
+            RideSpillFile spill((std::filesystem::temp_directory_path() /
+                                 ("ride_bench." + std::to_string(::getpid()) + ".spill")).string());
+            Driver driver(1, "Bench Driver", 4.5, store);
+            driver.spillHistoryTo(spill, 1024);
+            for (RideHandle handle : handles) {
+                driver.addRide(handle);
+            }
+            doNotOptimize(driver.getTotalEarnings());
+        });
+
+        Rider rider(1, "Bench Rider", store);
+        for (RideHandle handle : handles) {
+            rider.restoreRide(handle);
+        }
+        runBenchmark("rider_total_recompute", rides, [&] {
+            doNotOptimize(store.totalFare(handles));
+        });
+        runBenchmark("rider_total_cached", rides, [&] {
+            doNotOptimize(rider.getTotalSpent());
+        }, true);
+        rider.publishSnapshot();
+        runBenchmark("rider_snapshot_read", rides, [&] {
+            EpochGuard guard;
+            doNotOptimize(rider.snapshot(guard).spending.amount);
+        }, true);
+
+        std::string csv;
+        for (int d = 0; d < 100; ++d) {
+            csv += "driver," + std::to_string(1000 + d) + ",Driver " + std::to_string(d) + ",4.7\n";
+            csv += "rider," + std::to_string(5000 + d) + ",Rider " + std::to_string(d) + "\n";
+        }
+        for (size_t i = 0; i < rides; ++i) {
+            csv += "ride," + std::to_string(i) + (typeOf(i) == RideType::Premium ? ",Premium," : ",Standard,") +
+                   "Downtown,Airport," + std::to_string(distanceOf(i)) + "," + std::to_string(1000 + i % 100) +
+                   "," + std::to_string(5000 + i % 97) + "\n";
+        }
+        runBenchmark("csv_split", rides, [&] {
+            size_t records = 0;
+            forEachCsvRecord(csv, [&](std::span<const std::string_view>) { ++records; });
+            doNotOptimize(records);
+        });
+        runBenchmark("bulk_import", rides, [&] {
+            RideArena importArena;
+            RideStore importStore;
+            doNotOptimize(importRideRecords(csv, importArena, importStore).rides.size());
+        });
+
+        ReportWriter out;
+        runBenchmark("render_ride_details", rides, [&] {
+            for (RideHandle handle : handles) {
+                store.getRide(handle).renderDetails(out);
+            }
+            doNotOptimize(out.view().data());
+            out.clear();
+        });
+        runBenchmark("render_history_cached", rides, [&] {
+            rider.renderRides(out);
+            doNotOptimize(out.view().data());
+            out.clear();
+        });
+        runBenchmark("render_statement", rides, [&] {
+            rider.renderStatement(out);
+            doNotOptimize(out.view().data());
+            out.clear();
+        });
+    }
+}
+
+// Ownership-model costs for sharing a ride: creation with make_shared,
+// make_unique and makeIntrusive, then handing one ride to `holders`
+// owners (copy into a vector and drop them), single-threaded and with
+// several threads copying the same ride at once. unique_ptr cannot be
+// copied, so its owners borrow raw pointers. Run with --bench-ownership.
+void benchmarkOwnership(size_t maxThreads = 8) {
+    using Clock = std::chrono::steady_clock;
+    constexpr size_t holders = 1000;
+    std::cout << "\n=== RIDE OWNERSHIP BENCHMARK ===" << std::endl;
+    std::cout << std::left << std::setw(24) << "benchmark" << std::right << std::setw(10) << "ops"
+              << std::setw(20) << "time" << std::endl;
+    LocationId downtown = LocationTable::shared().intern("Downtown");
+    LocationId airport = LocationTable::shared().intern("Airport");
+
+    runBenchmark("create_make_shared", holders, [&] {
+        for (size_t i = 0; i < holders; ++i) {
+            doNotOptimize(std::make_shared<StandardRide>(1, downtown, airport, 10.0).get());
+        }
+    });
+    runBenchmark("create_make_unique", holders, [&] {
+        for (size_t i = 0; i < holders; ++i) {
+            doNotOptimize(std::make_unique<StandardRide>(1, downtown, airport, 10.0).get());
+        }
+    });
+    runBenchmark("create_intrusive", holders, [&] {
+        for (size_t i = 0; i < holders; ++i) {
+            doNotOptimize(makeIntrusive<StandardRide>(1, downtown, airport, 10.0).get());
+        }
+    });
+
+    auto shared = std::make_shared<StandardRide>(1, downtown, airport, 10.0);
+    auto unique = std::make_unique<StandardRide>(1, downtown, airport, 10.0);
+    auto atomicRide = makeIntrusive<StandardRide>(1, downtown, airport, 10.0);
+    auto localRide = makeIntrusive<StandardRide, LocalRefCount>(1, downtown, airport, 10.0);
+    // Fills a vector of holders from one ride and drops them again
+    auto fanOut = [](const auto& ride) {
+        using Handle = std::decay_t<decltype(ride)>;
+        std::vector<Handle> owners;
+        owners.reserve(holders);
+        return [ride, owners]() mutable {
+            for (size_t i = 0; i < holders; ++i) {
+                owners.push_back(ride);
+            }
+            doNotOptimize(owners.data());
+            owners.clear();
+        };
+    };
+    runBenchmark("copy_shared_ptr", holders, fanOut(shared));
+    runBenchmark("copy_intrusive_atomic", holders, fanOut(atomicRide));
+    runBenchmark("copy_intrusive_local", holders, fanOut(localRide));
+    runBenchmark("borrow_unique_ptr", holders, fanOut(unique.get()));
+
+    // libstdc++ keeps shared_ptr counts non-atomic until the process starts
+    // a second thread; the ride system always has worker threads
+    std::thread([] {}).join();
+    runBenchmark("create_make_shared_mt", holders, [&] {
+        for (size_t i = 0; i < holders; ++i) {
+            doNotOptimize(std::make_shared<StandardRide>(1, downtown, airport, 10.0).get());
+        }
+    });
+    runBenchmark("copy_shared_ptr_mt", holders, fanOut(shared));
+
+    // Contended: every thread copies the same ride, so the count's cache
+    // line moves between cores on each atomic update. Time is wall time
+    // over all threads' operations.
+    std::cout << "Hardware threads: " << std::thread::hardware_concurrency() << std::endl;
+    auto contended = [&](std::string_view name, size_t threads, auto makeBody) {
+        constexpr size_t rounds = 2000;
+        std::vector<std::thread> workers;
+        std::atomic<size_t> ready{0};
+        auto begin = Clock::now();
+        for (size_t t = 0; t < threads; ++t) {
+            workers.emplace_back([&] {
+                auto body = makeBody();
+                ready.fetch_add(1);
+                while (ready.load() < threads) {
+                    std::this_thread::yield();
+                }
+                for (size_t r = 0; r < rounds; ++r) {
+                    body();
+                }
+            });
+        }
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+        double ns = std::chrono::duration<double, std::nano>(Clock::now() - begin).count();
+        std::cout << std::left << std::setw(24) << (std::string(name) + " x" + std::to_string(threads)) << std::right
+                  << std::setw(10) << threads * rounds * holders << std::setw(12) << std::fixed << std::setprecision(2)
+                  << ns / static_cast<double>(threads * rounds * holders) << " ns/op" << std::defaultfloat << std::endl;
+    };
+    for (size_t threads = 2; threads <= maxThreads; threads *= 2) {
+        contended("copy_shared_ptr", threads, [&] { return fanOut(shared); });
+        contended("copy_intrusive_atomic", threads, [&] { return fanOut(atomicRide); });
+        contended("borrow_unique_ptr", threads, [&] { return fanOut(unique.get()); });
+    }
+}
+
+// Snapshot reads against live ingestion: one writer assigns rides to a
+// driver, publishing once per batch of rides as the dispatcher does, while
+// `readers` threads query its snapshot in a loop. The writer's time is
+// reported per ride both as wall time and as its thread CPU time, which
+// excludes the time readers spend on a shared core, so it shows
+// whether readers slow ingestion down rather than merely share the
+// machine. Each query also checks that ride count and earnings belong to
+// the same moment. Run with --bench-snapshots.
+void benchmarkSnapshots(size_t maxReaders = 4) {
+    constexpr size_t rides = 200000;
+    constexpr size_t batch = 64; // Rides per published snapshot
+    using Clock = std::chrono::steady_clock;
+    std::cout << "\n=== SNAPSHOT READ BENCHMARK ===" << std::endl;
+    std::cout << std::left << std::setw(12) << "readers" << std::right << std::setw(16) << "ingest wall"
+              << std::setw(16) << "ingest cpu" << std::setw(14) << "queries" << std::setw(14) << "torn" << std::endl;
+    LocationId downtown = LocationTable::shared().intern("Downtown");
+    LocationId airport = LocationTable::shared().intern("Airport");
+    RideArena arena;
+    RideStore store;
+    std::vector<RideHandle> handles;
+    handles.reserve(rides);
+    for (size_t i = 0; i < rides; ++i) {
+        handles.push_back(store.emplace<StandardRide>(arena, static_cast<int>(i), downtown, airport, 10.0));
+    }
+    Money fare = store.chargeAt(handles.front()); // Every ride is the same trip
+    auto threadCpuNanos = [] {
+        timespec now {};
+        ::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+        return static_cast<double>(now.tv_sec) * 1e9 + static_cast<double>(now.tv_nsec);
+    };
+
+    for (size_t readers = 0; readers <= maxReaders; readers = readers ? readers * 2 : 1) {
+        Driver driver(1, "Bench Driver", 4.5, store);
+        std::atomic<bool> done{false};
+        std::atomic<size_t> queries{0};
+        std::atomic<size_t> torn{0};
+        std::vector<std::thread> workers;
+        for (size_t r = 0; r < readers; ++r) {
+            workers.emplace_back([&] {
+                size_t local = 0;
+                size_t mismatched = 0;
+                while (!done.load(std::memory_order_relaxed)) {
+                    EpochGuard guard;
+                    const DriverSnapshot& view = driver.snapshot(guard);
+                    mismatched += view.earnings.amount.getCents() !=
+                                  fare.getCents() * static_cast<std::int64_t>(view.earnings.rides);
+                    ++local;
+                }
+                queries.fetch_add(local);
+                torn.fetch_add(mismatched);
+            });
+        }
+        auto begin = Clock::now();
+        double cpuBegin = threadCpuNanos();
+        for (size_t i = 0; i < rides; ++i) {
+            driver.addRide(handles[i]);
+            if (i % batch == batch - 1) {
+                driver.publishSnapshot();
+            }
+        }
+        driver.publishSnapshot();
+        double cpu = threadCpuNanos() - cpuBegin;
+        double wall = std::chrono::duration<double, std::nano>(Clock::now() - begin).count();
+        done.store(true);
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+        std::cout << std::left << std::setw(12) << readers << std::right << std::fixed << std::setprecision(2)
+                  << std::setw(10) << wall / rides << " ns/op" << std::setw(10) << cpu / rides << " ns/op"
+                  << std::setw(14) << queries.load() << std::setw(14) << torn.load() << std::defaultfloat << std::endl;
+    }
+    EpochDomain& domain = EpochDomain::shared();
+    domain.collect();
+    std::cout << "Snapshots freed: " << domain.getFreedCount() << ", pending: " << domain.getPendingCount() << std::endl;
+}
+
 // Demonstration function showing polymorphism
-void demonstratePolymorphism(const std::vector<std::shared_ptr<Ride>>& rides) {
-    std::cout << "\n=== POLYMORPHISM DEMONSTRATION ===" << std::endl;
-    std::cout << "Processing different ride types polymorphically:" << std::endl;
+void demonstratePolymorphism(const RideStore& rides, ReportSink& sink = consoleSink()) {
+    ReportWriter& out = consoleReport();
+    out << "\n=== POLYMORPHISM DEMONSTRATION ===\n";
+    out << "Processing different ride types polymorphically:\n";
     
-    double totalFares = 0.0;
-    for (const auto& ride : rides) {
-        std::cout << "\n--- " << ride->getRideType() << " Ride ---" << std::endl;
-        ride->rideDetails(); // Polymorphic call
-        totalFares += ride->fare(); // Polymorphic call
+    for (RideStore::Index row = 0; row < rides.size(); ++row) {
+        if (!rides.isLive(row)) {
+            continue;
+        }
+        const Ride& ride = rides.getRide(rides.handleAt(row));
+        out << "\n--- " << ride.getRideType() << " Ride ---\n";
+        ride.renderDetails(out); // Polymorphic call
     }
+    Money totalFares = rides.totalFare(); // Columnar scan
     
-    std::cout << "\nTotal Fares for All Rides: $" << std::fixed << std::setprecision(2) << totalFares << std::endl;
+    out << "\nTotal Fares for All Rides: $" << totalFares << '\n';
+    out.flushTo(sink);
 }
 
-int main() {
+// Demonstration function showing variant-based (devirtualized) dispatch
+void demonstrateVariantDispatch(const std::vector<RideVariant>& rides) {
+    std::cout << "\n=== VARIANT DISPATCH DEMONSTRATION ===" << std::endl;
+    for (const auto& ride : rides) {
+        std::cout << rideTypeName(rideTypeOf(ride)) << " ride fare: $"
+                  << std::fixed << std::setprecision(2) << fare(ride) << std::endl;
+    }
+    std::cout << "Total Fares (std::visit): $" << std::fixed << std::setprecision(2) << totalFare(rides) << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    // --ledger PATH: also persist the demo rides and reopen them via mmap
+    // --wal PATH:    log assignments/requests and recover them afterwards
+    // --stream:       windowed totals over ride events read from stdin
+    // --bench [MAX]:  hot-path micro-benchmarks from 1k up to MAX rides (10M)
+    // --bench-async [MAX]: coroutine vs thread-per-request latency, up to MAX requests
+    // --alloc-profile [N]: heap allocations per ride request (tracking builds only)
+    // --bench-ownership [THREADS]: shared_ptr vs unique_ptr vs IntrusivePtr costs
+    // --bench-snapshots [READERS]: ride ingestion while threads read driver snapshots
+    // --metrics:      print Prometheus metrics after the demo
+    // --import PATH:  bulk-load ride/driver/rider CSV records and summarize
+    const char* ledgerPath = nullptr;
+    const char* walPath = nullptr;
+    bool streaming = false;
+    bool exportMetrics = false;
+    const char* importPath = nullptr;
+    std::int64_t windowSeconds = 60;
+    std::int64_t slideSeconds = 60;
+    for (int i = 1; i < argc; ++i) {
+        std::string_view arg(argv[i]);
+        if (arg == "--bench-dispatch") {
+            benchmarkDispatcher();
+            return 0;
+        } else if (arg == "--bench-async") {
+            benchmarkAsyncRequests(i + 1 < argc ? std::strtoull(argv[i + 1], nullptr, 10) : 10000);
+            return 0;
+        } else if (arg == "--bench-snapshots") {
+            benchmarkSnapshots(i + 1 < argc ? std::strtoull(argv[i + 1], nullptr, 10) : 4);
+            return 0;
+        } else if (arg == "--bench-ownership") {
+            benchmarkOwnership(i + 1 < argc ? std::strtoull(argv[i + 1], nullptr, 10) : 8);
+            return 0;
+        } else if (arg == "--alloc-profile") {
+#if defined(RIDE_ALLOCATION_TRACKING)
+            profileAllocations(i + 1 < argc ? std::strtoull(argv[i + 1], nullptr, 10) : 10000);
+#else
+            std::cout << "Allocation tracking was compiled out (build with -DRIDE_ALLOCATION_TRACKING)" << std::endl;
+#endif
+            return 0;
+        } else if (arg == "--bench") {
+            runBenchmarks(i + 1 < argc ? std::strtoull(argv[i + 1], nullptr, 10) : 10000000);
+            return 0;
+        } else if (arg == "--ledger" && i + 1 < argc) {
+            ledgerPath = argv[++i];
+        } else if (arg == "--wal" && i + 1 < argc) {
+            walPath = argv[++i];
+        } else if (arg == "--import" && i + 1 < argc) {
+            importPath = argv[++i];
+        } else if (arg == "--metrics") {
+            exportMetrics = true;
+        } else if (arg == "--stream") {
+            streaming = true;
+        } else if (arg == "--window" && i + 1 < argc) {
+            windowSeconds = std::atoll(argv[++i]);
+        } else if (arg == "--slide" && i + 1 < argc) {
+            slideSeconds = std::atoll(argv[++i]);
+        }
+    }
+    if (streaming) {
+        runStreamingTotals(windowSeconds, slideSeconds);
+        return 0;
+    }
+    if (importPath != nullptr) {
+        RideArena arena;
+        RideStore store;
+        auto begin = std::chrono::steady_clock::now();
+        RideImport imported = importRideFile(importPath, arena, store);
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+        struct stat info {};
+        ::stat(importPath, &info);
+        std::cout << "=== BULK IMPORT ===" << std::endl;
+        std::cout << "Imported " << imported.rides.size() << " rides, " << imported.drivers.size() << " drivers, "
+                  << imported.riders.size() << " riders (" << imported.malformedRecords << " malformed records)"
+                  << std::endl;
+        std::cout << "Elapsed: " << std::fixed << std::setprecision(1) << elapsed.count() * 1e3 << " ms ("
+                  << static_cast<double>(info.st_size) / 1e6 / elapsed.count() << " MB/s)" << std::endl;
+        std::cout << "Total Fares: $" << store.totalFare() << std::endl;
+        return 0;
+    }
+
     std::cout << "=== RIDE SHARING SYSTEM - C++ IMPLEMENTATION ===" << std::endl;
     std::cout << "Demonstrating OOP Principles: Encapsulation, Inheritance, and Polymorphism" << std::endl;
 
+    // Map coordinates (miles) for the demo locations
+    LocationTable& locations = LocationTable::shared();
+    locations.intern("Downtown", {0.0, 0.0});
+    locations.intern("Airport", {12.0, 9.5});
+    locations.intern("Hotel", {1.2, 0.8});
+    locations.intern("Convention Center", {6.5, 5.0});
+    locations.intern("Mall", {-4.0, 3.0});
+    locations.intern("University", {-9.0, 8.0});
+    locations.intern("Luxury Resort", {30.0, 22.0});
+    locations.setZone(locations.intern("Airport"), 1); // Airport surge zone
+
     // Create different types of rides (inheritance and polymorphism)
-    auto standardRide1 = std::make_shared<StandardRide>(1, "Downtown", "Airport", 15.5);
-    auto premiumRide1 = std::make_shared<PremiumRide>(2, "Hotel", "Convention Center", 8.2);
-    auto standardRide2 = std::make_shared<StandardRide>(3, "Mall", "University", 12.0);
-    auto premiumRide2 = std::make_shared<PremiumRide>(4, "Airport", "Luxury Resort", 25.8);
+    // The arena is declared first so it outlives every ride drawn from it
+    RideArena shift;
+    RideStore fleet;
+    auto standardRide1 = fleet.emplace<StandardRide>(shift, nextRideID(), "Downtown", "Airport", 15.5);
+    auto premiumRide1 = fleet.emplace<PremiumRide>(shift, nextRideID(), "Hotel", "Convention Center", 8.2);
+    auto standardRide2 = fleet.emplace<StandardRide>(shift, nextRideID(), "Mall", "University", 12.0);
+    auto premiumRide2 = fleet.emplace<PremiumRide>(shift, nextRideID(), "Airport", "Luxury Resort", 25.8);
 
     // Create driver and rider objects (encapsulation)
-    Driver driver1(101, "John Smith", 4.8);
-    Driver driver2(102, "Sarah Johnson", 4.9);
-    Rider rider1(201, "Alice Brown");
-    Rider rider2(202, "Bob Wilson");
+    Driver driver1(nextDriverID(), "John Smith", 4.8, fleet);
+    Driver driver2(nextDriverID(), "Sarah Johnson", 4.9, fleet);
+    Rider rider1(nextRiderID(), "Alice Brown", fleet);
+    Rider rider2(nextRiderID(), "Bob Wilson", fleet);
+
+    std::unique_ptr<WriteAheadLog> wal;
+    if (walPath != nullptr) {
+        wal = std::make_unique<WriteAheadLog>(walPath);
+        driver1.addListener(*wal);
+        driver2.addListener(*wal);
+        rider1.addListener(*wal);
+        rider2.addListener(*wal);
+    }
+
+    // Leaderboard follows earnings as rides are assigned
+    DriverLeaderboard leaderboard;
+    for (Driver* driver : {&driver1, &driver2}) {
+        leaderboard.update(*driver);
+        driver->addListener(leaderboard);
+    }
 
     // Assign rides to drivers
     driver1.addRide(standardRide1);
@@ -209,17 +5753,259 @@ int main() {
     rider2.requestRide(premiumRide1);
     rider2.requestRide(standardRide2);
 
-    // Display driver information (encapsulation demonstration)
-    driver1.getDriverInfo();
-    driver2.getDriverInfo();
+    // End of the assignment batch: publish each view once
+    for (Driver* driver : {&driver1, &driver2}) {
+        driver->publishSnapshot();
+    }
+    for (Rider* rider : {&rider1, &rider2}) {
+        rider->publishSnapshot();
+    }
+
+    // Display driver information and rider ride history as a statement
+    // batch (rendered in parallel, written in order)
+    WorkStealingPool statementPool;
+    const Driver* drivers[] = {&driver1, &driver2};
+    const Rider* riders[] = {&rider1, &rider2};
+    writeDriverStatements(statementPool, drivers, consoleSink());
+    writeRiderStatements(statementPool, riders, consoleSink());
 
-    // Display rider ride history (encapsulation demonstration)
-    rider1.viewRides();
-    rider2.viewRides();
+    std::cout << "\n=== DRIVER LEADERBOARD ===" << std::endl;
+    std::cout << std::fixed << std::setprecision(2);
+    for (const DriverLeaderboard::Entry& entry : leaderboard.topByEarnings(10)) {
+        std::cout << "Earnings: driver " << entry.driverID << " $" << entry.earnings << std::endl;
+    }
+    for (const DriverLeaderboard::Entry& entry : leaderboard.topByRating(10)) {
+        std::cout << "Rating: driver " << entry.driverID << " " << entry.rating << "/5.0" << std::endl;
+    }
+    std::cout << std::defaultfloat;
 
     // Demonstrate polymorphism with mixed ride types
-    std::vector<std::shared_ptr<Ride>> allRides = {standardRide1, premiumRide1, standardRide2, premiumRide2};
-    demonstratePolymorphism(allRides);
+    demonstratePolymorphism(fleet);
+
+    // Same rides as a closed set of value types (no virtual dispatch)
+    std::vector<RideVariant> valueRides;
+    valueRides.emplace_back(std::in_place_type<StandardRide>, fleet.getRideID(standardRide1), "Downtown", "Airport", 15.5);
+    valueRides.emplace_back(std::in_place_type<PremiumRide>, fleet.getRideID(premiumRide1), "Hotel", "Convention Center", 8.2);
+    valueRides.emplace_back(std::in_place_type<StandardRide>, fleet.getRideID(standardRide2), "Mall", "University", 12.0);
+    valueRides.emplace_back(std::in_place_type<PremiumRide>, fleet.getRideID(premiumRide2), "Airport", "Luxury Resort", 25.8);
+    demonstrateVariantDispatch(valueRides);
+
+    std::cout << "\n=== RIDE ARENA ===" << std::endl;
+    std::cout << "Allocations: " << shift.getAllocationCount() << std::endl;
+    std::cout << "Bytes allocated to rides: " << shift.getBytesAllocated() << std::endl;
+    std::cout << "Bytes reserved from heap: " << shift.getBytesReserved() << std::endl;
+
+    // Match each ride's pickup to the nearest available driver
+    std::cout << "\n=== NEAREST DRIVER MATCHING ===" << std::endl;
+    DriverLocator locator;
+    locator.updatePosition(driver1.getDriverID(), {0.5, -0.3});
+    locator.updatePosition(driver2.getDriverID(), {-3.5, 2.5});
+    for (RideStore::Index row = 0; row < fleet.size(); ++row) {
+        const Ride& ride = fleet.getRide(fleet.handleAt(row));
+        std::vector<int> nearest = locator.nearest(ride.getPickupPoint(), 1);
+        std::cout << "Ride " << ride.getRideID() << " pickup at " << ride.getPickupLocation()
+                  << ": nearest driver " << nearest.front() << std::endl;
+    }
+
+    // Pool compatible requests into shared trips, matched in micro-batches
+    std::cout << "\n=== RIDE POOLING ===" << std::endl;
+    {
+        RideArena poolArena;
+        RideStore poolRides;
+        Driver poolDriver1(nextDriverID(), "Maria Garcia", 4.7, poolRides);
+        Driver poolDriver2(nextDriverID(), "Wei Chen", 4.6, poolRides);
+        DriverLocator poolLocator;
+        poolLocator.updatePosition(poolDriver1.getDriverID(), {0.2, 0.1});
+        poolLocator.updatePosition(poolDriver2.getDriverID(), {-4.2, 3.1});
+        // Off-pool driver parked closest to the first pickups: never assigned
+        const int offPoolDriverID = nextDriverID();
+        poolLocator.updatePosition(offPoolDriverID, {0.0, 0.0});
+        PoolingOptions pooling;
+        pooling.pickupRadius = 1.5;
+        RidePoolingMatcher matcher(poolRides, poolLocator, pooling);
+        matcher.addDriver(poolDriver1);
+        matcher.addDriver(poolDriver2);
+        matcher.submit(poolRides.emplace<StandardRide>(poolArena, nextRideID(), "Downtown", "Airport", 15.5), 0, 600);
+        matcher.submit(poolRides.emplace<StandardRide>(poolArena, nextRideID(), "Hotel", "Airport", 14.0), 100, 600);
+        matcher.submit(poolRides.emplace<PremiumRide>(poolArena, nextRideID(), "Mall", "University", 6.4), 150, 600);
+        matcher.submit(poolRides.emplace<StandardRide>(poolArena, nextRideID(), "Downtown", "Convention Center", 8.2), 200, 600);
+        auto printBatch = [&](std::int64_t now) {
+            for (const PooledTrip& trip : matcher.runBatch(now)) {
+                std::cout << "Batch at " << now << " ms: driver " << trip.driverID << " takes rides ";
+                for (size_t i = 0; i < trip.rides.size(); ++i) {
+                    std::cout << (i ? ", " : "") << poolRides.getRideID(trip.rides[i]);
+                }
+                std::cout << std::endl;
+            }
+            std::cout << "Pending after batch: " << matcher.getPendingCount() << std::endl;
+        };
+        printBatch(300);
+        poolLocator.setAvailable(poolDriver1.getDriverID(), true); // First trip completed
+        printBatch(600);
+        std::cout << "Trips: " << matcher.getTripCount() << ", rides matched: " << matcher.getMatchedRideCount()
+                  << ", expired: " << matcher.getExpiredCount() << std::endl;
+    }
+
+    // Bounded history: only the latest rides stay in memory, older ones are
+    // paged back from the spill file when the full history is viewed
+    std::cout << "\n=== RIDE HISTORY SPILL ===" << std::endl;
+    {
+        RideArena spillArena;
+        RideStore spillRides;
+        RideSpillFile spill((std::filesystem::temp_directory_path() /
+                             ("ride_history." + std::to_string(::getpid()) + ".spill")).string());
+        Rider rider3(nextRiderID(), "Carol Davis", spillRides);
+        rider3.spillHistoryTo(spill, 2);
+        RideHandle first = rider3.emplaceRide<StandardRide>(spillRides, spillArena, nextRideID(), "University", "Mall", 12.0);
+        rider3.emplaceRide<PremiumRide>(spillRides, spillArena, nextRideID(), "Mall", "Airport", 16.4);
+        rider3.emplaceRide<StandardRide>(spillRides, spillArena, nextRideID(), "Airport", "Downtown", 15.5);
+        spillRides.remove(first); // Rendered from its spilled record from now on
+        std::cout << "Rides in memory: " << rider3.getRideCount() - rider3.getSpilledRideCount()
+                  << ", spilled: " << rider3.getSpilledRideCount() << " (" << spill.getSize() << " bytes)" << std::endl;
+        rider3.viewRides();
+    }
+
+    // Ride requests as coroutines: all three are in flight at once on one
+    // thread, each awaiting its pricing, matching and persistence steps
+    std::cout << "\n=== ASYNC RIDE REQUESTS ===" << std::endl;
+    {
+        RideArena asyncArena;
+        RideStore asyncRides;
+        Driver asyncDriver1(nextDriverID(), "Ana Lopez", 4.8, asyncRides);
+        Driver asyncDriver2(nextDriverID(), "Tom Baker", 4.5, asyncRides);
+        Rider asyncRider(nextRiderID(), "Dan Evans", asyncRides);
+        DriverLocator asyncLocator;
+        asyncLocator.updatePosition(asyncDriver1.getDriverID(), {0.4, 0.2});
+        asyncLocator.updatePosition(asyncDriver2.getDriverID(), {-4.0, 2.9});
+        // Driver of another dispatcher parked at the Hotel: never assigned here
+        asyncLocator.updatePosition(nextDriverID(), {1.2, 0.8});
+        EventLoop loop;
+        AsyncRideOptions timing;
+        timing.pricingLatency = timing.matchingLatency = timing.persistLatency = std::chrono::milliseconds(1);
+        AsyncRideDispatcher dispatcher(loop, asyncRides, asyncArena, asyncLocator, timing);
+        dispatcher.addDriver(asyncDriver1);
+        dispatcher.addDriver(asyncDriver2);
+        auto book = [&](int rideID, std::string_view pickup, std::string_view dropoff, double dist,
+                        int requestedDriverID = 0) -> Task<void> {
+            RideRequest request;
+            request.rideID = rideID;
+            request.driverID = requestedDriverID;
+            request.pickup = locations.intern(pickup);
+            request.dropoff = locations.intern(dropoff);
+            request.distance = dist;
+            AsyncRideResult result = co_await dispatcher.request(asyncRider, request);
+            std::cout << "Ride " << rideID << " from " << pickup << ": ";
+            if (result.driverID == 0) {
+                std::cout << "no driver available" << std::endl;
+            } else {
+                std::cout << "driver " << result.driverID << ", fare $" << std::fixed << std::setprecision(2)
+                          << result.fare << std::defaultfloat << std::endl;
+            }
+        };
+        loop.spawn(book(nextRideID(), "Hotel", "Airport", 14.0));
+        // Asks for Ana Lopez, who is busy with the Hotel ride by then: falls
+        // back to the nearest free driver
+        loop.spawn(book(nextRideID(), "Mall", "University", 6.4, asyncDriver1.getDriverID()));
+        loop.spawn(book(nextRideID(), "Downtown", "Mall", 5.0));
+        loop.run();
+        std::cout << "Dan Evans spent: $" << std::fixed << std::setprecision(2) << asyncRider.getTotalSpent()
+                  << std::defaultfloat << std::endl;
+    }
+
+    // Analytics reads a point-in-time snapshot while the driver keeps taking
+    // rides; the report itself runs on another thread
+    std::cout << "\n=== SNAPSHOT QUERIES ===" << std::endl;
+    {
+        RideArena snapshotArena;
+        RideStore snapshotRides;
+        Driver driver5(nextDriverID(), "Eve Foster", 4.7, snapshotRides);
+        driver5.emplaceRide<StandardRide>(snapshotRides, snapshotArena, nextRideID(), "Downtown", "Airport", 15.5);
+        driver5.publishSnapshot();
+        auto describe = [](const DriverSnapshot& view) {
+            std::cout << view.earnings.rides << (view.earnings.rides == 1 ? " ride, $" : " rides, $") << std::fixed << std::setprecision(2)
+                      << view.earnings.amount << std::defaultfloat << std::endl;
+        };
+        {
+            EpochGuard guard;
+            const DriverSnapshot& before = driver5.snapshot(guard);
+            std::cout << "Snapshot of " << before.name << " (ID: " << before.driverID << "): ";
+            describe(before);
+            driver5.emplaceRide<PremiumRide>(snapshotRides, snapshotArena, nextRideID(), "Hotel", "Airport", 9.0);
+            driver5.publishSnapshot();
+            std::cout << "After another ride, the same snapshot still reads: ";
+            describe(before);
+            std::cout << "Latest snapshot: ";
+            describe(driver5.snapshot(guard));
+        }
+        std::thread([&] {
+            ReportWriter& out = consoleReport();
+            driver5.renderInfo(out);
+            out.flushTo(consoleSink());
+        }).join();
+    }
+
+    // Publish a surge table (zone 1 = Airport pickups): new rides are quoted
+    // under it, rides already taken keep their fares
+    std::cout << "\n=== SURGE PRICING ===" << std::endl;
+    SurgePricing& surge = SurgePricing::shared();
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "Fleet total before surge: $" << fleet.totalFare() << std::endl;
+    surge.publish(SurgeTable(2, 1, {1.0, 1.5}));
+    std::cout << "Surge table v" << surge.getVersion() << " published: Airport pickups x1.50" << std::endl;
+    PremiumRide quote(0, "Airport", "Luxury Resort", 25.8); // Priced, not booked
+    std::cout << "New Airport pickup like ride 4 is quoted: $" << Money::fromDollars(quote.fare()) << std::endl;
+    std::cout << "Ride 4 keeps its fare: $" << fleet.chargeAt(premiumRide2) << std::endl;
+    std::cout << "Fleet total under surge: $" << fleet.totalFare() << std::endl;
+    surge.publish(SurgeTable());
+    EpochDomain::shared().collect(); // No reader is pinned here, so both replaced tables are freed
+    std::cout << std::defaultfloat;
+
+    if (ledgerPath != nullptr) {
+        writeRideLedger(ledgerPath, fleet);
+        MappedRideLedger ledger(ledgerPath);
+        std::cout << "\n=== RIDE LEDGER ===" << std::endl;
+        std::cout << "Saved " << ledger.size() << " rides, " << ledger.getLocationCount()
+                  << " locations to " << ledgerPath << std::endl;
+        for (const LedgerRecord& record : ledger.records()) {
+            std::cout << "Ride " << record.rideID << ": " << ledger.locationName(record.pickup) << " -> "
+                      << ledger.locationName(record.dropoff) << std::endl;
+        }
+        std::cout << "Total Fares (mapped): $" << std::fixed << std::setprecision(2) << ledger.totalFare() << std::endl;
+        RideArena loadArena;
+        RideStore loadedRides;
+        std::vector<RideHandle> loaded = loadRideLedger(ledger, loadArena, loadedRides);
+        std::cout << "Loaded " << loaded.size() << " rides back, Total Fares: $" << loadedRides.totalFare() << std::endl;
+    }
+
+    if (wal) {
+        wal.reset(); // Final group commit, as on shutdown
+        RideArena recoveryArena;
+        RideStore recoveredRides;
+        Driver recovered1(driver1.getDriverID(), "John Smith", 4.8, recoveredRides);
+        Driver recovered2(driver2.getDriverID(), "Sarah Johnson", 4.9, recoveredRides);
+        Rider recoveredRider1(rider1.getRiderID(), "Alice Brown", recoveredRides);
+        Rider recoveredRider2(rider2.getRiderID(), "Bob Wilson", recoveredRides);
+        size_t events = recoverFromLog(walPath, recoveryArena, recoveredRides,
+                                       {{recovered1.getDriverID(), &recovered1}, {recovered2.getDriverID(), &recovered2}},
+                                       {{recoveredRider1.getRiderID(), &recoveredRider1}, {recoveredRider2.getRiderID(), &recoveredRider2}});
+        std::cout << "\n=== WRITE-AHEAD LOG RECOVERY ===" << std::endl;
+        std::cout << "Replayed " << events << " events into " << recoveredRides.size() << " rides" << std::endl;
+        recovered1.getDriverInfo();
+        recovered2.getDriverInfo();
+        std::cout << "Alice Brown spent: $" << std::fixed << std::setprecision(2) << recoveredRider1.getTotalSpent() << std::endl;
+        std::cout << "Bob Wilson spent: $" << std::fixed << std::setprecision(2) << recoveredRider2.getTotalSpent() << std::endl;
+    }
+
+    if (exportMetrics) {
+        std::cout << "\n=== METRICS (PROMETHEUS) ===" << std::endl;
+#if RIDE_METRICS
+        ReportWriter& out = consoleReport();
+        MetricsRegistry::shared().renderPrometheus(out);
+        out.flushTo(consoleSink());
+#else
+        std::cout << "Metrics were compiled out (RIDE_METRICS=0)" << std::endl;
+#endif
+    }
 
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,95 @@
+#ifndef ID_GENERATOR_H
+#define ID_GENERATOR_H
+
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+
+/**
+ * Block-allocating ID generator
+ * The thread-safe, allocation-free successor of makeCounter() from
+ * TypeSystemsScopesandClosures.cpp: instead of a std::function wrapping a
+ * captured int, a concrete callable draws blocks of IDs from a shared atomic.
+ */
+
+// IdSequence - shared source of unique int IDs, handed out in blocks.
+// One atomic fetch_add reserves a whole block, so threads drawing IDs
+// through their own IdGenerator touch the shared counter once per block
+// rather than once per ID.
+// IDs loaded from outside (an import or a recovered log) are reserved with
+// advancePast(), which also retires any block a generator holds below them.
+// next and floor sit on separate cache lines: reservations write next, while
+// every generator reads floor on every call.
+class IdSequence {
+private:
+    alignas(64) std::atomic<std::int64_t> next;
+    alignas(64) std::atomic<std::int64_t> floor; // Lowest ID that may still be handed out
+    int blockSize;
+
+public:
+    explicit IdSequence(int first = 1, int idsPerBlock = 64) : next(first), floor(first), blockSize(idsPerBlock) {
+        if (idsPerBlock <= 0) {
+            throw std::invalid_argument("IdSequence: block size must be positive");
+        }
+    }
+
+    IdSequence(const IdSequence&) = delete;
+    IdSequence& operator=(const IdSequence&) = delete;
+
+    // First ID of a newly reserved block of getBlockSize() IDs. Throws
+    // without reserving anything once a full block no longer fits in int.
+    int reserveBlock() {
+        const std::int64_t lastBegin = static_cast<std::int64_t>(std::numeric_limits<int>::max()) - blockSize + 1;
+        std::int64_t begin = next.load(std::memory_order_relaxed);
+        do {
+            if (begin > lastBegin) {
+                throw std::overflow_error("IdSequence: IDs exhausted");
+            }
+        } while (!next.compare_exchange_weak(begin, begin + blockSize, std::memory_order_relaxed));
+        return static_cast<int>(begin);
+    }
+
+    // Ensures no later ID is id or lower, e.g. after loading records with
+    // explicit IDs. Generators drop blocks that reach below the new floor.
+    void advancePast(int id) {
+        std::int64_t wanted = static_cast<std::int64_t>(id) + 1;
+        std::int64_t current = next.load(std::memory_order_relaxed);
+        while (current < wanted && !next.compare_exchange_weak(current, wanted, std::memory_order_relaxed)) {
+        }
+        current = floor.load(std::memory_order_relaxed);
+        while (current < wanted && !floor.compare_exchange_weak(current, wanted, std::memory_order_release)) {
+        }
+    }
+
+    std::int64_t getFloor() const { return floor.load(std::memory_order_acquire); }
+    int getBlockSize() const { return blockSize; }
+};
+
+// IdGenerator - one thread's view of an IdSequence. A plain callable, so
+// calls inline and nothing is heap allocated:
+//   IdGenerator nextID(sequence);
+//   int id = nextID();
+// A generator is not itself thread safe; give each thread its own. IDs from
+// one generator increase; across generators they are unique but interleave
+// by block, and IDs left in a block when a generator is destroyed, or when
+// the sequence is advanced past them, are skipped.
+class IdGenerator {
+private:
+    IdSequence* sequence;
+    std::int64_t nextID = 0;
+    std::int64_t blockEnd = 0;
+
+public:
+    explicit IdGenerator(IdSequence& source) : sequence(&source) {}
+
+    int operator()() {
+        if (nextID == blockEnd || nextID < sequence->getFloor()) {
+            nextID = sequence->reserveBlock();
+            blockEnd = nextID + sequence->getBlockSize();
+        }
+        return static_cast<int>(nextID++);
+    }
+};
+
+#endif